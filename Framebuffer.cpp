@@ -1,31 +1,20 @@
 #include "Framebuffer.h"
+#include <cstring>
 #include <GL/glew.h>
 #include "Shader.h"
+#include "GLState.h"
+#include "Profiler.h"
 
-Framebuffer::Framebuffer(Shader s, int width, int height)
+Framebuffer::Framebuffer(int width, int height)
 {
     this->width = width;
     this->height = height;
-    shader = s;
-    glGenFramebuffers(1, &fbo); //create a frame buffer
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-
-    /*glGenRenderbuffers(1, &rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-    glRenderbufferStorageMultisample(GL_RENDERBUFFER, 8, GL_RGB, width, height);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rbo);*/
-
-    glGenTextures(1, &texColorBuffer); //create and bind a texture
-    glBindTexture(GL_TEXTURE_2D, texColorBuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGRA, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texColorBuffer, 0); //and attach it to the FBO
+    glGenFramebuffers(2, fbo); //create the frame buffers
+    glGenTextures(2, texColorBuffer);
+    allocateTargets();
 
     glGenVertexArrays(1, &vao); //create and bind a VAO
-    glBindVertexArray(vao);
+    GLState::get().bindVertexArray(vao);
 
     float vertices[] = {
         //x, y, s, t
@@ -53,13 +42,7 @@ Framebuffer::Framebuffer(Shader s, int width, int height)
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4*sizeof(float), (void*)(0));
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4*sizeof(float), (void*)(2*sizeof(float)));
 
-    s.Use();
-    //s.SetFloat("strength", 0.01);
-    s.SetBool("shake", false);
-
-    glBindVertexArray(0);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::get().bindFramebuffer(0);
 }
 
 Framebuffer::~Framebuffer()
@@ -67,52 +50,157 @@ Framebuffer::~Framebuffer()
     glDeleteBuffers(1, &vbo); //delete everything
     glDeleteBuffers(1, &ebo);
     glDeleteVertexArrays(1, &vao);
-    glDeleteTextures(1, &texColorBuffer);
-    glDeleteRenderbuffers(1, &rbo);
-    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(2, texColorBuffer);
+    glDeleteFramebuffers(2, fbo);
+    GLState::get().invalidate(); //the names can be handed out again
+}
+
+PostPass *Framebuffer::find(const char *name)
+{
+    for (unsigned int i=0;i<passes.size();i++)
+    {
+        if (strcmp(passes[i].name, name) == 0)
+            return &passes[i];
+    }
+    return NULL;
+}
+
+void Framebuffer::AddPass(const char *name, Shader shader, bool enabled)
+{
+    PostPass pass;
+    pass.name = name;
+    pass.shader = shader;
+    pass.enabled = enabled;
+    passes.push_back(pass);
+}
+
+bool Framebuffer::RemovePass(const char *name)
+{
+    for (unsigned int i=0;i<passes.size();i++)
+    {
+        if (strcmp(passes[i].name, name) == 0)
+        {
+            passes.erase(passes.begin() + i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Framebuffer::EnablePass(const char *name, bool enabled)
+{
+    PostPass *pass = find(name);
+    if (pass)
+        pass->enabled = enabled;
 }
 
-void Framebuffer::Bind()
+unsigned int Framebuffer::ActivePasses() const
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    unsigned int active = 0;
+    for (unsigned int i=0;i<passes.size();i++)
+    {
+        if (passes[i].enabled)
+            active++;
+    }
+    return active;
 }
 
-void Framebuffer::BindTextureBuffer()
+void Framebuffer::allocateTargets()
 {
-    //glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texColorBuffer);
+    targetWidth = (int)(width*scale + 0.5f);
+    targetHeight = (int)(height*scale + 0.5f);
+    if (targetWidth < 1)
+        targetWidth = 1;
+    if (targetHeight < 1)
+        targetHeight = 1;
+    for (int i=0;i<2;i++)
+    {
+        GLState::get().bindFramebuffer(fbo[i]);
+
+        GLState::get().bindTexture(texColorBuffer[i]); //(re)create the texture at the new size
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, targetWidth, targetHeight, 0, GL_BGRA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); //bilinear upscale in the last pass
+
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texColorBuffer[i], 0); //and attach it to the FBO
+    }
+    GLState::get().bindFramebuffer(0);
+}
+
+void Framebuffer::SetScale(float scale)
+{
+    if (scale == this->scale)
+        return;
+    this->scale = scale;
+    allocateTargets();
 }
 
 void Framebuffer::BindDefaultFrameBuffer()
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::get().bindFramebuffer(0);
 }
 
 void Framebuffer::BeginRender()
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    glClearColor(0.0, 0.0, 0.0, 1.0);
+    //nothing to post-process or scale, skip the offscreen round trip entirely
+    offscreen = (ActivePasses() != 0 || targetWidth != width || targetHeight != height);
+    GLState::get().bindFramebuffer(offscreen ? fbo[0] : 0);
+    if (offscreen)
+        glViewport(0, 0, targetWidth, targetHeight);
+    else
+        glViewport(0, 0, width, height);
+    GLState::get().clearColor(0.0, 0.0, 0.0, 1.0);
     glClear(GL_COLOR_BUFFER_BIT);
 }
 
 void Framebuffer::EndRender()
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::get().bindFramebuffer(0);
 }
 
-void Framebuffer::Render(bool bindTexture)
+void Framebuffer::Render()
 {
-    glClearColor(0.0, 0.0, 0.0, 1.0);
-    glClear(GL_COLOR_BUFFER_BIT);
-    shader.Use();
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    if (bindTexture)
+    if (offscreen) //otherwise the scene is already in the window
+        runPasses();
+    if (capture)
+        capture->capture();
+}
+
+void Framebuffer::runPasses()
+{
+    PROFILE_SCOPE("Framebuffer::Render");
+    unsigned int remaining = ActivePasses();
+    unsigned int source = 0;
+    if (remaining == 0) //only scaled, stretch it into the window
+    {
+        PROFILE_GPU_BEGIN("upscale");
+        GLState::get().bindFramebuffer(0);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo[0]); //the cache only tracks GL_FRAMEBUFFER (both)...
+        glBlitFramebuffer(0, 0, targetWidth, targetHeight, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0); //...so put it back the way it thinks it is
+        glViewport(0, 0, width, height);
+        PROFILE_GPU_END();
+        return;
+    }
+    GLState::get().bindVertexArray(vao); //the VAO already has the vertex and element buffers
+    for (unsigned int i=0;i<passes.size();i++)
     {
-        //glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texColorBuffer);
+        if (!passes[i].enabled)
+            continue;
+        remaining--;
+        PROFILE_GPU_BEGIN(passes[i].name);
+        //the last pass draws into the window, the others into whichever target we didn't just read
+        GLState::get().bindFramebuffer(remaining == 0 ? 0 : fbo[1 - source]);
+        if (remaining == 0)
+            glViewport(0, 0, width, height); //upscales as it samples
+        else
+            glViewport(0, 0, targetWidth, targetHeight);
+        GLState::get().clearColor(0.0, 0.0, 0.0, 1.0);
+        glClear(GL_COLOR_BUFFER_BIT);
+        passes[i].shader.Use();
+        GLState::get().bindTexture(0, texColorBuffer[source]);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        PROFILE_GPU_END();
+        source = 1 - source;
     }
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
 }
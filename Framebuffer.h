@@ -1,30 +1,59 @@
 #ifndef FRAMEBUFFER_H
 #define FRAMEBUFFER_H
+#include <vector>
 #include "Shader.h"
+#include "FrameCapture.h"
 
+//one full-screen effect, reads the previous image from texture unit 0 ("scene")
+struct PostPass {
+    const char *name; //also its profiler timer, so it has to outlive the pass (use a literal)
+    Shader shader;
+    bool enabled;
+};
+
+//post-processing chain: the scene is drawn into an offscreen target and every enabled
+//pass draws it into the next one, ping-ponging between two targets, with the last
+//pass drawing to the window. With no pass enabled the scene goes straight to the
+//window and the chain costs nothing.
+//The targets can be smaller than the window (SetScale), the last pass (or a blit,
+//when there are no passes) stretches the image back up to the window size
 class Framebuffer
 {
     public:
-        Framebuffer(Shader s, int width, int height);
+        Framebuffer(int width, int height);
         ~Framebuffer();
 
-        GLuint fbo;
-        GLuint rbo;
-        GLuint texColorBuffer;
-        Shader shader;
+        GLuint fbo[2]; //the ping-pong targets
+        GLuint texColorBuffer[2];
         GLuint vao;
         GLuint vbo;
         GLuint ebo;
 
-        int width;
+        int width; //the window
         int height;
+        float scale = 1.0; //of the targets, relative to the window
+        int targetWidth;
+        int targetHeight;
+
+        std::vector<PostPass> passes; //in the order they run
+        FrameCapture *capture = nullptr; //when set, every finished frame is recorded (see FrameCapture)
+
+        //change passes before BeginRender, it decides whether the frame goes offscreen
+        void AddPass(const char *name, Shader shader, bool enabled = true); //at the end of the chain
+        bool RemovePass(const char *name);
+        void EnablePass(const char *name, bool enabled);
+        unsigned int ActivePasses() const;
+        void SetScale(float scale); //reallocates the targets, between frames only
 
-        void Bind();
-        void BindTextureBuffer();
-        void Render(bool bindTexture);
-        void BeginRender();
+        void BeginRender(); //binds where the scene should go and clears it
         void EndRender();
+        void Render(); //runs the enabled passes, the result ends up in the default framebuffer (and the capture)
         static void BindDefaultFrameBuffer();
+    protected:
+        bool offscreen = false; //the scene went to fbo[0] this frame
+        PostPass *find(const char *name);
+        void allocateTargets();
+        void runPasses();
 };
 
 #endif // FRAMEBUFFER_H
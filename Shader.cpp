@@ -1,121 +1,364 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 #include "Shader.h"
+#include "FrameUniforms.h"
+#include "GLState.h"
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+std::string Shader::CacheDirectory = "shadercache";
+
+static bool hasExtension(const char *name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Programs are only left to build in the background when the driver can tell us it's done
+static bool parallelCompile()
+{
+    static int supported = -1;
+    if (supported == -1)
+        supported = hasExtension("GL_KHR_parallel_shader_compile");
+    return supported == 1;
+}
+
+static bool binaryCache()
+{
+    static GLint formats = -1;
+    if (formats == -1)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0 && !Shader::CacheDirectory.empty();
+}
+
+// FNV-1a, good enough to tell sources apart
+static unsigned long long hashString(unsigned long long hash, const char *text)
+{
+    for (; *text; text++)
+    {
+        hash ^= (unsigned char)*text;
+        hash *= 1099511628211ULL;
+    }
+    return (hash ^ 0xFF)*1099511628211ULL; // separator, so "ab"+"c" != "a"+"bc"
+}
+
+// A binary only works on the driver that made it, so that's part of the key too
+static unsigned long long driverHash()
+{
+    static unsigned long long hash = 0;
+    if (hash == 0)
+    {
+        GLenum strings[] = {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION};
+        hash = 14695981039346656037ULL;
+        for (int i = 0; i < 4; i++)
+        {
+            const GLubyte *value = glGetString(strings[i]);
+            hash = hashString(hash, value ? (const char*)value : "");
+        }
+    }
+    return hash;
+}
+
+static std::string cachePath(unsigned long long key)
+{
+    char name[32];
+    sprintf(name, "/%016llx.bin", key);
+    return Shader::CacheDirectory + name;
+}
 
 Shader &Shader::Use()
 {
-    glUseProgram(this->ID);
+    if (build && build->pending)
+        finish();
+    GLState::get().useProgram(this->ID);
     return *this;
 }
 
 void Shader::Compile(const GLchar* vertexSource, const GLchar* fragmentSource, const GLchar* geometrySource)
 {
-    GLuint sVertex, sFragment, gShader;
-    // Vertex Shader
-    sVertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(sVertex, 1, &vertexSource, NULL);
-    glCompileShader(sVertex);
-    checkCompileErrors(sVertex, "VERTEX");
-    // Fragment Shader
-    sFragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(sFragment, 1, &fragmentSource, NULL);
-    glCompileShader(sFragment);
-    checkCompileErrors(sFragment, "FRAGMENT");
-    // If geometry shader source code is given, also compile geometry shader
-    if (geometrySource != nullptr)
+    const GLchar *sources[] = {vertexSource, fragmentSource, geometrySource};
+    const GLenum types[] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER};
+    // Geometry shader source code is optional
+    buildProgram(sources, types, (geometrySource != nullptr) ? 3 : 2, nullptr, 0);
+}
+
+void Shader::CompileFeedback(const GLchar *vertexSource, const GLchar **varyings, GLsizei varyingCount)
+{
+    const GLchar *sources[] = {vertexSource};
+    const GLenum types[] = {GL_VERTEX_SHADER};
+    buildProgram(sources, types, 1, varyings, varyingCount);
+}
+
+void Shader::buildProgram(const GLchar **sources, const GLenum *types, int count, const GLchar **varyings, GLsizei varyingCount)
+{
+    build = std::make_shared<Build>();
+    build->cacheKey = driverHash();
+    for (int i = 0; i < count; i++)
+        build->cacheKey = hashString(build->cacheKey, sources[i]);
+    for (GLsizei i = 0; i < varyingCount; i++)
+        build->cacheKey = hashString(build->cacheKey, varyings[i]);
+    if (loadBinary())
+        return;
+
+    // Nothing below waits on the driver, the checks happen in finish()
+    this->ID = glCreateProgram();
+    for (int i = 0; i < count; i++)
     {
-        gShader = glCreateShader(GL_GEOMETRY_SHADER);
-        glShaderSource(gShader, 1, &geometrySource, NULL);
-        glCompileShader(gShader);
-        checkCompileErrors(gShader, "GEOMETRY");
+        GLuint stage = glCreateShader(types[i]);
+        glShaderSource(stage, 1, &sources[i], NULL);
+        glCompileShader(stage);
+        glAttachShader(this->ID, stage);
+        build->stages[i] = stage;
+        build->stageTypes[i] = (types[i] == GL_VERTEX_SHADER) ? "VERTEX" : (types[i] == GL_FRAGMENT_SHADER) ? "FRAGMENT" : "GEOMETRY";
     }
-    // Shader Program
-    this->ID = glCreateProgram();
-    glAttachShader(this->ID, sVertex);
-    glAttachShader(this->ID, sFragment);
-    if (geometrySource != nullptr)
-        glAttachShader(this->ID, gShader);
+    build->stageCount = count;
+    // The captured outputs have to be named before linking
+    if (varyingCount > 0)
+        glTransformFeedbackVaryings(this->ID, varyingCount, varyings, GL_INTERLEAVED_ATTRIBS);
+    if (binaryCache())
+        glProgramParameteri(this->ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(this->ID);
-    checkCompileErrors(this->ID, "PROGRAM");
-    // Delete the shaders as they're linked into our program now and no longer necessery
-    glDeleteShader(sVertex);
-    glDeleteShader(sFragment);
-    if (geometrySource != nullptr)
-        glDeleteShader(gShader);
+    build->pending = true;
+    if (!parallelCompile()) // the driver would block on the first check anyway
+        finish();
+}
+
+bool Shader::Ready() const
+{
+    if (!build || !build->pending)
+        return true;
+    if (!parallelCompile())
+        return false;
+    GLint done = GL_FALSE;
+    glGetProgramiv(this->ID, GL_COMPLETION_STATUS_KHR, &done);
+    return done == GL_TRUE;
+}
+
+void Shader::finish() const
+{
+    build->pending = false;
+    for (int i = 0; i < build->stageCount; i++)
+    {
+        checkCompileErrors(build->stages[i], build->stageTypes[i]);
+        // Delete the shaders as they're linked into our program now and no longer necessery
+        glDeleteShader(build->stages[i]);
+    }
+    build->stageCount = 0;
+    if (checkCompileErrors(this->ID, "PROGRAM"))
+        saveBinary();
+    cacheUniforms();
+}
+
+bool Shader::loadBinary()
+{
+    if (!binaryCache())
+        return false;
+    std::ifstream file(cachePath(build->cacheKey).c_str(), std::ios::binary);
+    GLenum format;
+    if (!file.read((char*)&format, sizeof(format)))
+        return false;
+    std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.empty())
+        return false;
+
+    this->ID = glCreateProgram();
+    glProgramBinary(this->ID, format, &data[0], data.size());
+    GLint linked = GL_FALSE;
+    glGetProgramiv(this->ID, GL_LINK_STATUS, &linked);
+    if (!linked) // the driver changed under us or the file is bad, build it again and overwrite it
+    {
+        glDeleteProgram(this->ID);
+        return false;
+    }
+    cacheUniforms();
+    return true;
+}
+
+void Shader::saveBinary() const
+{
+    if (!binaryCache())
+        return;
+    GLint length = 0;
+    glGetProgramiv(this->ID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    std::vector<char> data(length);
+    GLenum format;
+    glGetProgramBinary(this->ID, length, NULL, &format, &data[0]);
+#ifdef _WIN32
+    _mkdir(CacheDirectory.c_str());
+#else
+    mkdir(CacheDirectory.c_str(), 0755);
+#endif
+    std::ofstream file(cachePath(build->cacheKey).c_str(), std::ios::binary);
+    file.write((const char*)&format, sizeof(format));
+    file.write(&data[0], data.size());
+}
+
+void Shader::cacheUniforms() const
+{
+    std::map<std::string, GLint> &uniforms = build->uniforms;
+    uniforms.clear();
+    GLint count = 0;
+    glGetProgramiv(this->ID, GL_ACTIVE_UNIFORMS, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+        GLchar name[256];
+        GLsizei length;
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(this->ID, i, sizeof(name), &length, &size, &type, name);
+        std::string uniformName(name, length);
+        // Arrays are reported as "name[0]", store them under the plain name
+        std::string::size_type bracket = uniformName.find('[');
+        if (bracket != std::string::npos)
+            uniformName.erase(bracket);
+        // Members of uniform blocks have no location and aren't cached
+        GLint location = glGetUniformLocation(this->ID, name);
+        if (location != -1)
+            uniforms[uniformName] = location;
+    }
+    // Hook the per-frame block up to its shared binding point
+    GLuint frameBlock = glGetUniformBlockIndex(this->ID, "Frame");
+    if (frameBlock != GL_INVALID_INDEX)
+        glUniformBlockBinding(this->ID, frameBlock, FrameUniforms::BINDING);
+}
+
+GLint Shader::GetLocation(const GLchar *name) const
+{
+    if (!build)
+        return -1;
+    if (build->pending)
+        finish();
+    std::map<std::string, GLint>::const_iterator it = build->uniforms.find(name);
+    return (it != build->uniforms.end()) ? it->second : -1;
 }
 
 void Shader::SetFloat(const GLchar *name, GLfloat value, GLboolean useShader)
 {
     if (useShader)
         this->Use();
-    glUniform1f(glGetUniformLocation(this->ID, name), value);
+    glUniform1f(this->GetLocation(name), value);
 }
 
 void Shader::SetInteger(const GLchar *name, GLint value, GLboolean useShader)
 {
     if (useShader)
         this->Use();
-    glUniform1i(glGetUniformLocation(this->ID, name), value);
+    glUniform1i(this->GetLocation(name), value);
 }
 
 void Shader::SetVector2f(const GLchar *name, GLfloat x, GLfloat y, GLboolean useShader)
 {
     if (useShader)
         this->Use();
-    glUniform2f(glGetUniformLocation(this->ID, name), x, y);
+    glUniform2f(this->GetLocation(name), x, y);
 }
 
 void Shader::SetVector2f(const GLchar *name, const glm::vec2 &value, GLboolean useShader)
 {
     if (useShader)
         this->Use();
-    glUniform2f(glGetUniformLocation(this->ID, name), value.x, value.y);
+    glUniform2f(this->GetLocation(name), value.x, value.y);
 }
 
 void Shader::SetVector3f(const GLchar *name, GLfloat x, GLfloat y, GLfloat z, GLboolean useShader)
 {
     if (useShader)
         this->Use();
-    glUniform3f(glGetUniformLocation(this->ID, name), x, y, z);
+    glUniform3f(this->GetLocation(name), x, y, z);
 }
 
 void Shader::SetVector3f(const GLchar *name, const glm::vec3 &value, GLboolean useShader)
 {
     if (useShader)
         this->Use();
-    glUniform3f(glGetUniformLocation(this->ID, name), value.x, value.y, value.z);
+    glUniform3f(this->GetLocation(name), value.x, value.y, value.z);
 }
 
 void Shader::SetVector4f(const GLchar *name, GLfloat x, GLfloat y, GLfloat z, GLfloat w, GLboolean useShader)
 {
     if (useShader)
         this->Use();
-    glUniform4f(glGetUniformLocation(this->ID, name), x, y, z, w);
+    glUniform4f(this->GetLocation(name), x, y, z, w);
 }
 
 void Shader::SetVector4f(const GLchar *name, const glm::vec4 &value, GLboolean useShader)
 {
     if (useShader)
         this->Use();
-    glUniform4f(glGetUniformLocation(this->ID, name), value.x, value.y, value.z, value.w);
+    glUniform4f(this->GetLocation(name), value.x, value.y, value.z, value.w);
 }
 
 void Shader::SetMatrix4(const GLchar *name, const glm::mat4 &matrix, GLboolean useShader)
 {
     if (useShader)
         this->Use();
-    glUniformMatrix4fv(glGetUniformLocation(this->ID, name), 1, GL_FALSE, glm::value_ptr(matrix));
+    glUniformMatrix4fv(this->GetLocation(name), 1, GL_FALSE, glm::value_ptr(matrix));
 }
 
 void Shader::SetBool(const GLchar* name, bool value, GLboolean useShader)
 {
     if (useShader)
         this->Use();
-    glUniform1i(glGetUniformLocation(this->ID, name), value);
+    glUniform1i(this->GetLocation(name), value);
+}
+
+void Shader::Set(Uniform<GLfloat> u, GLfloat value)
+{
+    glUniform1f(u.location, value);
+}
+
+void Shader::Set(Uniform<GLint> u, GLint value)
+{
+    glUniform1i(u.location, value);
+}
+
+void Shader::Set(Uniform<bool> u, bool value)
+{
+    glUniform1i(u.location, value);
+}
+
+void Shader::Set(Uniform<glm::vec2> u, const glm::vec2 &value)
+{
+    glUniform2f(u.location, value.x, value.y);
+}
+
+void Shader::Set(Uniform<glm::vec3> u, const glm::vec3 &value)
+{
+    glUniform3f(u.location, value.x, value.y, value.z);
+}
+
+void Shader::Set(Uniform<glm::vec4> u, const glm::vec4 &value)
+{
+    glUniform4f(u.location, value.x, value.y, value.z, value.w);
+}
+
+void Shader::Set(Uniform<glm::mat4> u, const glm::mat4 &value)
+{
+    glUniformMatrix4fv(u.location, 1, GL_FALSE, glm::value_ptr(value));
 }
 
-void Shader::checkCompileErrors(GLuint object, std::string type)
+bool Shader::checkCompileErrors(GLuint object, std::string type) const
 {
     GLint success;
     GLchar infoLog[1024];
@@ -141,4 +384,5 @@ void Shader::checkCompileErrors(GLuint object, std::string type)
                 << std::endl;
         }
     }
+    return success;
 }
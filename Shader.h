@@ -1,9 +1,19 @@
 #ifndef SHADER_H
 #define SHADER_H
 #include <iostream>
+#include <map>
+#include <memory>
+#include <string>
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
+// Typed handle to a uniform location, resolved once with Shader::GetUniform
+template <typename T>
+struct Uniform
+{
+    GLint location = -1;
+};
+
 class Shader
 {
     public:
@@ -15,6 +25,13 @@ class Shader
         Shader  &Use();
         // Compiles the shader from given source code
         void    Compile(const GLchar *vertexSource, const GLchar *fragmentSource, const GLchar *geometrySource = nullptr); // Note: geometry source code is optional
+        // Compiles a vertex-only program whose outputs are captured with transform feedback
+        void    CompileFeedback(const GLchar *vertexSource, const GLchar **varyings, GLsizei varyingCount);
+        // With GL_KHR_parallel_shader_compile the driver builds programs in the background and the
+        // error checks wait for the first use. True once the program can be used without stalling
+        bool    Ready() const;
+        // Linked programs are saved here and loaded instead of compiled next time, empty turns it off
+        static std::string CacheDirectory;
         // Utility functions
         void    SetFloat    (const GLchar *name, GLfloat value, GLboolean useShader = false);
         void    SetInteger  (const GLchar *name, GLint value, GLboolean useShader = false);
@@ -26,8 +43,45 @@ class Shader
         void    SetVector4f (const GLchar *name, const glm::vec4 &value, GLboolean useShader = false);
         void    SetMatrix4  (const GLchar *name, const glm::mat4 &matrix, GLboolean useShader = false);
         void    SetBool     (const GLchar *name, bool value, GLboolean useShader = false);
+        // Cached uniform lookup, locations are resolved once after linking
+        GLint   GetLocation (const GLchar *name) const;
+        template <typename T>
+        Uniform<T> GetUniform(const GLchar *name) const
+        {
+            Uniform<T> u;
+            u.location = GetLocation(name);
+            return u;
+        }
+        // Setters for resolved handles (no string lookups), the shader must be in use
+        void    Set         (Uniform<GLfloat> u, GLfloat value);
+        void    Set         (Uniform<GLint> u, GLint value);
+        void    Set         (Uniform<bool> u, bool value);
+        void    Set         (Uniform<glm::vec2> u, const glm::vec2 &value);
+        void    Set         (Uniform<glm::vec3> u, const glm::vec3 &value);
+        void    Set         (Uniform<glm::vec4> u, const glm::vec4 &value);
+        void    Set         (Uniform<glm::mat4> u, const glm::mat4 &value);
     private:
+        // Results of the last Compile, shared between copies of this Shader so it's only finished once
+        struct Build
+        {
+            bool pending = false; // compiled and linked but not checked yet
+            GLuint stages[3];
+            const char *stageTypes[3];
+            int stageCount = 0;
+            unsigned long long cacheKey = 0;
+            // Active uniform locations by name
+            std::map<std::string, GLint> uniforms;
+        };
+        std::shared_ptr<Build> build;
+        // Builds the program from source (or the binary cache), only waiting for it if it has to
+        void    buildProgram(const GLchar **sources, const GLenum *types, int count, const GLchar **varyings, GLsizei varyingCount);
+        // Waits for a pending build, prints any errors, fills the uniform cache and saves the binary
+        void    finish() const;
+        bool    loadBinary();
+        void    saveBinary() const;
+        // Fills the location cache and binds the shared uniform blocks
+        void    cacheUniforms() const;
             // Checks if compilation or linking failed and if so, print the error logs
-        void    checkCompileErrors(GLuint object, std::string type);
+        bool    checkCompileErrors(GLuint object, std::string type) const;
 };
 #endif
@@ -1,127 +1,6 @@
+#include <cmath>
 #include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
-#include <GL/glew.h>
 #include "Sprite.h"
-#include "Texture.h"
-#include "Shader.h"
-
-SpriteRenderer::SpriteRenderer(Shader shader, glm::mat4 proj)
-{
-    this->shader = shader;
-    this->projection = proj;
-    this->initRenderData();
-}
-
-SpriteRenderer::~SpriteRenderer()
-{
-    glDeleteBuffers(1, &quadVBO);
-    glDeleteBuffers(1, &quadEBO);
-    glDeleteVertexArrays(1, &quadVAO); //get rid of buffers to save memory
-}
-
-void SpriteRenderer::initRenderData()
-{
-    glGenVertexArrays(1, &quadVAO);
-    glGenBuffers(1, &quadVBO); //generate storage buffers
-    glGenBuffers(1, &quadEBO);
-    float vertices[] = {
-        0.0, 0.0, 0.0, 1.0,
-        1.0, 0.0, 1.0, 1.0,
-        1.0, -1.0, 1.0, 0.0,
-        0.0, -1.0, 0.0, 0.0
-    };
-    int elements[] = {
-        0, 1, 2,
-        2, 3, 0
-    };
-    glBindVertexArray(quadVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO); //store the data for the vertices
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadEBO); //and for the elements
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(elements), elements, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4*sizeof(float), (void*)(0));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4*sizeof(float), (void*)(2*sizeof(float)));
-    glBindVertexArray(0);
-}
-
-void SpriteRenderer::drawSprite(Texture2D &texture, Sprite sprite)
-{
-    shader.Use(); //use the shader
-    glm::mat4 model;
-    model = glm::translate(model, glm::vec3(sprite.position, 0.0f));
-
-    model = glm::translate(model, glm::vec3(0.5f*sprite.size.x, 0.5f*sprite.size.y, 0.0f));
-    model = glm::rotate(model, sprite.rotation, glm::vec3(0.0f, 0.0f, 1.0f));
-    model = glm::translate(model, glm::vec3(-0.5f*sprite.size.x, 0.5f*sprite.size.y, 0.0f));
-
-    model = glm::scale(model, glm::vec3(sprite.size, 1.0f)); //scale to the appropriate size
-
-    shader.SetMatrix4("model", model);
-    shader.SetMatrix4("proj", projection);
-    shader.SetVector3f("color", sprite.color.x, sprite.color.y, sprite.color.z);
-
-    glActiveTexture(GL_TEXTURE0);
-    texture.Bind(); //bind the texture
-
-    glBindVertexArray(this->quadVAO); //draw
-    //glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-    //glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadEBO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-}
-
-void SpriteRenderer::drawSprite(Texture2D &texture, RSprite sprite)
-{
-    shader.Use(); //use the shader
-    glm::mat4 model;
-    model = glm::translate(model, glm::vec3(sprite.position, 0.0f));
-
-    model = glm::translate(model, glm::vec3(0.5f*sprite.radius, 0.5f*sprite.radius, 0.0f));
-    model = glm::rotate(model, sprite.rotation, glm::vec3(0.0f, 0.0f, 1.0f));
-    model = glm::translate(model, glm::vec3(-0.5f*sprite.radius, 0.5f*sprite.radius, 0.0f));
-
-    model = glm::scale(model, glm::vec3(sprite.radius, sprite.radius, 1.0f)); //scale to the appropriate size
-
-    shader.SetMatrix4("model", model);
-    shader.SetMatrix4("proj", projection);
-    shader.SetVector3f("color", sprite.color.x, sprite.color.y, sprite.color.z);
-
-    glActiveTexture(GL_TEXTURE0);
-    texture.Bind(); //bind the texture
-
-    glBindVertexArray(this->quadVAO); //draw
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadEBO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-}
-
-void SpriteRenderer::drawSpriteNoTexture(Sprite sprite)
-{
-    shader.Use();
-    glm::mat4 model;
-    model = glm::translate(model, glm::vec3(sprite.position, 0.0));
-
-    model = glm::translate(model, glm::vec3(0.5f*sprite.size, 0.0));
-    model = glm::rotate(model, sprite.rotation, glm::vec3(0.0, 0.0, 1.0));
-    model = glm::translate(model, glm::vec3(-0.5f*sprite.size, 0.0));
-
-    model = glm::scale(model, glm::vec3(sprite.size, 1.0));
-
-    shader.SetMatrix4("model", model);
-    shader.SetMatrix4("proj", projection);
-    shader.SetVector3f("color", sprite.color);
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    glBindVertexArray(this->quadVAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-}
 
 bool checkCollision(Sprite &one, Sprite &two)
 {
@@ -153,3 +32,123 @@ bool checkCollision(Sprite& one, RSprite& two)
     difference = closest - center;
     return glm::length(difference) <= two.radius;
 }
+
+bool checkCollision(RSprite& one, RSprite& two)
+{
+    glm::vec2 difference = (one.position + one.radius) - (two.position + two.radius);
+    float reach = one.radius + two.radius;
+    return glm::dot(difference, difference) <= reach*reach;
+}
+
+//earliest t in [0, 1] where a circle moving by motion touches a point, if any
+static bool sweepCirclePoint(glm::vec2 center, float radius, glm::vec2 motion, glm::vec2 point, float &t)
+{
+    glm::vec2 m = center - point;
+    float a = glm::dot(motion, motion);
+    float b = glm::dot(m, motion);
+    float c = glm::dot(m, m) - radius*radius;
+    if (a == 0.0f || b >= 0.0f) //not moving, or moving away
+        return false;
+    float disc = b*b - a*c;
+    if (disc < 0.0f)
+        return false;
+    t = (-b - std::sqrt(disc))/a;
+    if (t < 0.0f) //already touching
+        t = 0.0f;
+    return t <= 1.0f;
+}
+
+Contact sweepCircleAABB(glm::vec2 center, float radius, glm::vec2 motion, const Sprite &box)
+{
+    Contact contact;
+    glm::vec2 boxMin = box.position, boxMax = box.position + box.size;
+
+    //already overlapping: push out along the line from the closest point on the box
+    glm::vec2 closest = glm::clamp(center, boxMin, boxMax);
+    glm::vec2 offset = center - closest;
+    if (glm::dot(offset, offset) < radius*radius) {
+        glm::vec2 normal;
+        if (offset.x == 0.0f && offset.y == 0.0f) { //center inside the box, use the nearest face
+            float left = center.x - boxMin.x, right = boxMax.x - center.x;
+            float top = center.y - boxMin.y, bottom = boxMax.y - center.y;
+            float nearest = glm::min(glm::min(left, right), glm::min(top, bottom));
+            normal = (nearest == left) ? glm::vec2(-1, 0) : (nearest == right) ? glm::vec2(1, 0) :
+                     (nearest == top) ? glm::vec2(0, -1) : glm::vec2(0, 1);
+        } else {
+            normal = glm::normalize(offset);
+        }
+        if (glm::dot(motion, normal) < 0.0f) {
+            contact.hit = true;
+            contact.time = 0.0f;
+            contact.normal = normal;
+        }
+        return contact;
+    }
+
+    //ray against the box grown by the radius (slab test)
+    glm::vec2 grownMin = boxMin - glm::vec2(radius, radius), grownMax = boxMax + glm::vec2(radius, radius);
+    float tEnter = 0.0f, tExit = 1.0f;
+    glm::vec2 normal(0.0, 0.0);
+    for (int axis=0;axis<2;axis++) {
+        if (motion[axis] == 0.0f) {
+            if (center[axis] < grownMin[axis] || center[axis] > grownMax[axis])
+                return contact;
+            continue;
+        }
+        float t0 = (grownMin[axis] - center[axis])/motion[axis];
+        float t1 = (grownMax[axis] - center[axis])/motion[axis];
+        float side = -1.0f; //entering through the min face
+        if (t0 > t1) {
+            float tmp = t0; t0 = t1; t1 = tmp;
+            side = 1.0f;
+        }
+        if (t0 > tEnter) {
+            tEnter = t0;
+            normal = glm::vec2(0.0, 0.0);
+            normal[axis] = side;
+        }
+        if (t1 < tExit)
+            tExit = t1;
+        if (tEnter > tExit)
+            return contact;
+    }
+    //the grown box has square corners but the real shape is rounded there,
+    //so a hit beyond both faces of a corner has to be checked against the corner itself.
+    //That's also the only way to start inside the grown box without overlapping (normal still zero)
+    glm::vec2 p = center + tEnter*motion;
+    bool outsideX = (p.x < boxMin.x || p.x > boxMax.x);
+    bool outsideY = (p.y < boxMin.y || p.y > boxMax.y);
+    if (outsideX && outsideY) {
+        glm::vec2 corner(p.x < boxMin.x ? boxMin.x : boxMax.x, p.y < boxMin.y ? boxMin.y : boxMax.y);
+        float t;
+        if (!sweepCirclePoint(center, radius, motion, corner, t))
+            return contact;
+        tEnter = t;
+        normal = glm::normalize(center + t*motion - corner);
+    } else if (normal == glm::vec2(0.0, 0.0)) {
+        return contact;
+    }
+    if (glm::dot(motion, normal) >= 0.0f) //moving away
+        return contact;
+
+    contact.hit = true;
+    contact.time = tEnter;
+    contact.normal = normal;
+    return contact;
+}
+
+Contact sweepCirclePlane(glm::vec2 center, float radius, glm::vec2 motion, glm::vec2 normal, float distance)
+{
+    Contact contact;
+    float gap = glm::dot(normal, center) - distance - radius; //how far the circle is in front of the plane
+    float approach = glm::dot(normal, motion);
+    if (approach >= 0.0f) //moving away or along it
+        return contact;
+    float t = (gap <= 0.0f) ? 0.0f : -gap/approach;
+    if (t > 1.0f)
+        return contact;
+    contact.hit = true;
+    contact.time = t;
+    contact.normal = normal;
+    return contact;
+}
@@ -3,9 +3,6 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
-#include <GL/glew.h>
-#include "Texture.h"
-#include "Shader.h"
 
 class Sprite
 {
@@ -14,11 +11,31 @@ class Sprite
         {
             this->position = position;
             this->size = Size;
+            savePrevious();
         }
         glm::vec2 position;
         float rotation = 0;
         glm::vec2 size;
         glm::vec3 color = glm::vec3(1.0, 1.0, 1.0);
+
+        //where it was before the last simulation tick, so rendering can blend between ticks
+        struct State {
+            glm::vec2 position;
+            float rotation;
+        };
+        State previous;
+        void savePrevious() //call at the start of a tick
+        {
+            previous.position = position;
+            previous.rotation = rotation;
+        }
+        Sprite interpolated(float alpha) const //alpha 0 is the previous state, 1 the current one
+        {
+            Sprite blended(*this);
+            blended.position = glm::mix(previous.position, position, alpha);
+            blended.rotation = previous.rotation + (rotation - previous.rotation)*alpha;
+            return blended;
+        }
         void move(glm::vec2 translation)
         {
             position += translation;
@@ -59,6 +76,18 @@ class Sprite
             trans = glm::scale(trans, glm::vec3(size, 1.0));
             return trans;
         }
+        glm::mat4 modelMatrix() const //model matrix used by the SpriteRenderer (rotates about the center)
+        {
+            glm::mat4 model;
+            model = glm::translate(model, glm::vec3(position, 0.0f));
+
+            model = glm::translate(model, glm::vec3(0.5f*size.x, 0.5f*size.y, 0.0f));
+            model = glm::rotate(model, rotation, glm::vec3(0.0f, 0.0f, 1.0f));
+            model = glm::translate(model, glm::vec3(-0.5f*size.x, 0.5f*size.y, 0.0f));
+
+            model = glm::scale(model, glm::vec3(size, 1.0f)); //scale to the appropriate size
+            return model;
+        }
 };
 
 class RSprite
@@ -89,6 +118,18 @@ class RSprite
         {
             radius += Scale;
         }
+        glm::mat4 modelMatrix() const
+        {
+            glm::mat4 model;
+            model = glm::translate(model, glm::vec3(position, 0.0f));
+
+            model = glm::translate(model, glm::vec3(0.5f*radius, 0.5f*radius, 0.0f));
+            model = glm::rotate(model, rotation, glm::vec3(0.0f, 0.0f, 1.0f));
+            model = glm::translate(model, glm::vec3(-0.5f*radius, 0.5f*radius, 0.0f));
+
+            model = glm::scale(model, glm::vec3(radius, radius, 1.0f)); //scale to the appropriate size
+            return model;
+        }
         /*glm::mat4 toMat4()
         {
             glm::mat4 trans;
@@ -99,25 +140,21 @@ class RSprite
         }*/
 };
 
-class SpriteRenderer
-{
-    public:
-        SpriteRenderer(Shader shader, glm::mat4 proj);
-        ~SpriteRenderer();
-        void drawSprite(Texture2D &texture, Sprite sprite);
-        void drawSprite(Texture2D &texture, RSprite sprite);
-        void drawSpriteNoTexture(Sprite sprite);
-    private:
-        Shader shader;
-        GLuint quadVAO;
-        GLuint quadVBO;
-        GLuint quadEBO;
-        glm::mat4 projection;
+bool checkCollision(Sprite& one, Sprite& two);
+bool checkCollision(Sprite& one, RSprite &two);
+bool checkCollision(RSprite& one, RSprite &two);
 
-        void initRenderData();
+//result of a swept test: the fraction of the motion (0 to 1) at which the
+//shapes first touch, and the surface normal pointing back at the mover
+struct Contact {
+    bool hit = false;
+    float time = 1.0;
+    glm::vec2 normal = glm::vec2(0.0, 0.0);
 };
 
-bool checkCollision(Sprite& one, Sprite& two);
-bool checkCollision(Sprite& one, RSprite &two);
+//circle moving by motion this step against a box, only reports hits the circle is moving into
+Contact sweepCircleAABB(glm::vec2 center, float radius, glm::vec2 motion, const Sprite &box);
+//circle moving against the plane dot(normal, p) == distance, only hits it from the front
+Contact sweepCirclePlane(glm::vec2 center, float radius, glm::vec2 motion, glm::vec2 normal, float distance);
 
 #endif // SPRITE_H
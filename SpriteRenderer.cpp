@@ -0,0 +1,189 @@
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <GL/glew.h>
+#include <algorithm>
+#include <cstddef>
+#include "SpriteRenderer.h"
+#include "Sprite.h"
+#include "Texture.h"
+#include "Shader.h"
+#include "GLState.h"
+
+SpriteRenderer::SpriteRenderer(Shader shader, Shader batchShader)
+{
+    this->shader = shader;
+    this->batchShader = batchShader;
+    modelUniform = shader.GetUniform<glm::mat4>("model"); //the projection comes from the Frame block
+    colorUniform = shader.GetUniform<glm::vec3>("color");
+    uvRectUniform = shader.GetUniform<glm::vec4>("uvRect");
+    this->initRenderData();
+}
+
+SpriteRenderer::~SpriteRenderer()
+{
+    glDeleteBuffers(1, &quadVBO);
+    glDeleteBuffers(1, &quadEBO);
+    glDeleteBuffers(1, &instanceVBO);
+    glDeleteVertexArrays(1, &quadVAO); //get rid of buffers to save memory
+    GLState::get().invalidate(); //the names can be handed out again
+}
+
+void SpriteRenderer::initRenderData()
+{
+    glGenVertexArrays(1, &quadVAO);
+    glGenBuffers(1, &quadVBO); //generate storage buffers
+    glGenBuffers(1, &quadEBO);
+    glGenBuffers(1, &instanceVBO);
+    float vertices[] = {
+        0.0, 0.0, 0.0, 1.0,
+        1.0, 0.0, 1.0, 1.0,
+        1.0, -1.0, 1.0, 0.0,
+        0.0, -1.0, 0.0, 0.0
+    };
+    int elements[] = {
+        0, 1, 2,
+        2, 3, 0
+    };
+    GLState::get().bindVertexArray(quadVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO); //store the data for the vertices
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadEBO); //and for the elements
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(elements), elements, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4*sizeof(float), (void*)(0));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4*sizeof(float), (void*)(2*sizeof(float)));
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO); //per-instance attributes: model (2-5), uv rect (6), color (7)
+    for (int i=2;i<=7;i++) {
+        glEnableVertexAttribArray(i);
+        glVertexAttribDivisor(i, 1);
+    }
+    setInstanceOffset(0);
+}
+
+void SpriteRenderer::setInstanceOffset(GLintptr offset)
+{
+    //instanceVBO and quadVAO must be bound
+    GLsizei stride = sizeof(Instance);
+    for (int i=0;i<4;i++) { //a mat4 attribute takes up four vec4 slots
+        glVertexAttribPointer(2 + i, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(Instance, model) + i*sizeof(glm::vec4)));
+    }
+    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(Instance, uvRect)));
+    glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(Instance, color)));
+}
+
+void SpriteRenderer::drawSprite(Texture2D &texture, const Sprite &sprite, glm::vec4 uvRect)
+{
+    shader.Use(); //use the shader
+    shader.Set(modelUniform, sprite.modelMatrix());
+    shader.Set(colorUniform, sprite.color);
+    shader.Set(uvRectUniform, uvRect);
+
+    GLState::get().bindTexture(0, texture.ID); //bind the texture
+
+    GLState::get().bindVertexArray(this->quadVAO); //draw
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+}
+
+void SpriteRenderer::drawSprite(Texture2D &texture, const RSprite &sprite, glm::vec4 uvRect)
+{
+    shader.Use(); //use the shader
+    shader.Set(modelUniform, sprite.modelMatrix());
+    shader.Set(colorUniform, sprite.color);
+    shader.Set(uvRectUniform, uvRect);
+
+    GLState::get().bindTexture(0, texture.ID); //bind the texture
+
+    GLState::get().bindVertexArray(this->quadVAO); //draw, the VAO already has the buffers
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+}
+
+void SpriteRenderer::drawSpriteNoTexture(const Sprite &sprite)
+{
+    shader.Use();
+    glm::mat4 model;
+    model = glm::translate(model, glm::vec3(sprite.position, 0.0));
+
+    model = glm::translate(model, glm::vec3(0.5f*sprite.size, 0.0));
+    model = glm::rotate(model, sprite.rotation, glm::vec3(0.0, 0.0, 1.0));
+    model = glm::translate(model, glm::vec3(-0.5f*sprite.size, 0.0));
+
+    model = glm::scale(model, glm::vec3(sprite.size, 1.0));
+
+    shader.Set(modelUniform, model);
+    shader.Set(colorUniform, sprite.color);
+    shader.Set(uvRectUniform, glm::vec4(0.0, 0.0, 1.0, 1.0));
+
+    GLState::get().bindTexture(0, 0);
+
+    GLState::get().bindVertexArray(this->quadVAO);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+}
+
+void SpriteRenderer::begin()
+{
+    batch.clear();
+}
+
+void SpriteRenderer::submit(Texture2D &texture, const Sprite &sprite, glm::vec4 uvRect)
+{
+    BatchItem item;
+    item.texture = texture.ID;
+    item.data.model = sprite.modelMatrix();
+    item.data.uvRect = uvRect;
+    item.data.color = sprite.color;
+    batch.push_back(item);
+}
+
+void SpriteRenderer::submit(Texture2D &texture, const RSprite &sprite, glm::vec4 uvRect)
+{
+    BatchItem item;
+    item.texture = texture.ID;
+    item.data.model = sprite.modelMatrix();
+    item.data.uvRect = uvRect;
+    item.data.color = sprite.color;
+    batch.push_back(item);
+}
+
+void SpriteRenderer::flush()
+{
+    drawCalls = 0;
+    if (batch.empty())
+        return;
+
+    //group sprites by texture, keeping submission order within a texture
+    std::stable_sort(batch.begin(), batch.end(),
+        [](const BatchItem &a, const BatchItem &b) { return a.texture < b.texture; });
+    instances.resize(batch.size());
+    for (unsigned int i=0;i<batch.size();i++) {
+        instances[i] = batch[i].data;
+    }
+
+    GLState::get().bindVertexArray(this->quadVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    if (instances.size() > instanceCapacity) { //grow the instance buffer
+        instanceCapacity = instances.size()*2;
+    }
+    //orphan the old storage so we don't wait on draws still using it
+    glBufferData(GL_ARRAY_BUFFER, instanceCapacity*sizeof(Instance), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size()*sizeof(Instance), &instances[0]);
+
+    batchShader.Use();
+    GLState::get().activeTexture(0);
+
+    unsigned int first = 0;
+    while (first < batch.size()) { //one instanced draw for each run of sprites sharing a texture
+        unsigned int last = first + 1;
+        while (last < batch.size() && batch[last].texture == batch[first].texture) {
+            last++;
+        }
+        GLState::get().bindTexture(batch[first].texture);
+        setInstanceOffset(first*sizeof(Instance));
+        glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, last - first);
+        drawCalls++;
+        first = last;
+    }
+    batch.clear();
+}
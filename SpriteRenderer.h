@@ -0,0 +1,56 @@
+#ifndef SPRITERENDERER_H
+#define SPRITERENDERER_H
+#include <glm/glm.hpp>
+#include <GL/glew.h>
+#include <vector>
+#include "Sprite.h"
+#include "Texture.h"
+#include "Shader.h"
+
+class SpriteRenderer
+{
+    public:
+        SpriteRenderer(Shader shader, Shader batchShader);
+        ~SpriteRenderer();
+        //immediate mode, one draw call per sprite
+        void drawSprite(Texture2D &texture, const Sprite &sprite, glm::vec4 uvRect = glm::vec4(0.0, 0.0, 1.0, 1.0));
+        void drawSprite(Texture2D &texture, const RSprite &sprite, glm::vec4 uvRect = glm::vec4(0.0, 0.0, 1.0, 1.0));
+        void drawSpriteNoTexture(const Sprite &sprite);
+        //batched mode, sprites submitted between begin() and flush() are drawn
+        //with one instanced draw call per texture
+        void begin();
+        void submit(Texture2D &texture, const Sprite &sprite, glm::vec4 uvRect = glm::vec4(0.0, 0.0, 1.0, 1.0));
+        void submit(Texture2D &texture, const RSprite &sprite, glm::vec4 uvRect = glm::vec4(0.0, 0.0, 1.0, 1.0));
+        void flush();
+
+        unsigned int drawCalls = 0; //draw calls issued by the last flush
+    private:
+        struct Instance { //per-sprite data, laid out as it is in the instance buffer
+            glm::mat4 model;
+            glm::vec4 uvRect;
+            glm::vec3 color;
+        };
+        struct BatchItem {
+            GLuint texture;
+            Instance data;
+        };
+
+        Shader shader;
+        Shader batchShader;
+        GLuint quadVAO;
+        GLuint quadVBO;
+        GLuint quadEBO;
+        GLuint instanceVBO;
+        Uniform<glm::mat4> modelUniform;
+        Uniform<glm::vec3> colorUniform;
+        Uniform<glm::vec4> uvRectUniform;
+
+        std::vector<BatchItem> batch;
+        std::vector<Instance> instances; //batch sorted by texture, ready for upload
+        unsigned int instanceCapacity = 0; //size of instanceVBO in instances
+
+        void initRenderData();
+        void setInstanceOffset(GLintptr offset);
+};
+
+#endif // SPRITERENDERER_H
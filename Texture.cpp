@@ -1,6 +1,7 @@
 #include <GL/glew.h>
 #include <iostream>
 #include "Texture.h"
+#include "GLState.h"
 
 Texture2D::Texture2D()
     : Width(0), Height(0), Internal_Format(GL_RGBA), Image_Format(GL_RGBA), Wrap_S(GL_REPEAT), Wrap_T(GL_REPEAT), Filter_Min(GL_LINEAR), Filter_Max(GL_LINEAR)
@@ -10,30 +11,27 @@ Texture2D::Texture2D()
 
 void Texture2D::Bind() const
 {
-    glBindTexture(GL_TEXTURE_2D, this->ID);
+    GLState::get().bindTexture(this->ID);
 }
 
 void Texture2D::Generate(GLuint width, GLuint height, unsigned char* data)
 {
     Width = width;
     Height = height;
-    glBindTexture(GL_TEXTURE_2D, this->ID);
+    Bind();
     glTexImage2D(GL_TEXTURE_2D, 0, this->Internal_Format, width, height, 0, this->Image_Format, GL_UNSIGNED_BYTE, data);
     // Set Texture wrap and filter modes
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, this->Wrap_S);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, this->Wrap_T);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, this->Filter_Min);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, this->Filter_Max);
-
-    // Unbind texture
-    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 void Texture2D::GenerateBlank()
 {
     Width = 1;
     Height = 1;
-    glBindTexture(GL_TEXTURE_2D, this->ID);
+    Bind();
     float blank_img[] = {1.0, 1.0, 1.0};
     glTexImage2D(GL_TEXTURE_2D, 0, this->Internal_Format, Width, Height, 0, this->Image_Format, GL_FLOAT, blank_img);
     // Set Texture wrap and filter modes
@@ -41,6 +39,4 @@ void Texture2D::GenerateBlank()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, this->Wrap_T);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, this->Filter_Min);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, this->Filter_Max);
-    // Unbind texture
-    glBindTexture(GL_TEXTURE_2D, 0);
 }
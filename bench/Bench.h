@@ -0,0 +1,108 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//tiny microbenchmark harness: every benchmark is a body that performs `size`
+//operations per call, timed over several runs, reported as ns/op
+
+//keeps the compiler from throwing away a result we never use
+template <typename T>
+inline void doNotOptimize(const T &value)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static volatile const void *sink;
+    sink = &value;
+#endif
+}
+
+struct BenchResult {
+    std::string name;
+    unsigned int size;
+    unsigned long long ops; //operations timed in the best run
+    double nsPerOp; //median over the runs
+    double minNsPerOp; //best run
+    double opsPerSecond; //from the median
+};
+
+class Bench
+{
+    public:
+        double minTime = 0.05; //seconds each run lasts at least
+        unsigned int runs = 5;
+        std::string filter; //only run benchmarks whose name contains this
+
+        std::vector<BenchResult> results;
+
+        template <typename Body>
+        void run(const std::string &name, unsigned int size, Body body)
+        {
+            if (!filter.empty() && name.find(filter) == std::string::npos)
+                return;
+            body(); //warm up caches and let the CPU clock up
+
+            //find how many calls fill minTime, then time that many calls `runs` times
+            unsigned long long calls = 1;
+            while (true) {
+                double t = timeCalls(body, calls);
+                if (t >= minTime)
+                    break;
+                calls = (t > 0.0) ? (unsigned long long)(calls*std::min(10.0, 1.2*minTime/t)) + 1 : calls*10;
+            }
+            std::vector<double> nsPerOp;
+            for (unsigned int r=0;r<runs;r++) {
+                nsPerOp.push_back(timeCalls(body, calls)*1e9/((double)calls*size));
+            }
+            std::sort(nsPerOp.begin(), nsPerOp.end());
+
+            BenchResult result;
+            result.name = name;
+            result.size = size;
+            result.ops = calls*size;
+            result.nsPerOp = nsPerOp[nsPerOp.size()/2];
+            result.minNsPerOp = nsPerOp[0];
+            result.opsPerSecond = 1e9/result.nsPerOp;
+            results.push_back(result);
+            printf("%-32s %10u %12.3f %12.3f %14.4g\n", name.c_str(), size, result.nsPerOp, result.minNsPerOp, result.opsPerSecond);
+            fflush(stdout);
+        }
+
+        void printHeader() const
+        {
+            printf("%-32s %10s %12s %12s %14s\n", "benchmark", "size", "ns/op", "min ns/op", "ops/s");
+        }
+
+        bool writeJSON(const char *path) const
+        {
+            FILE *f = fopen(path, "w");
+            if (!f)
+                return false;
+            fprintf(f, "{\n  \"runs\": %u,\n  \"min_time\": %g,\n  \"benchmarks\": [\n", runs, minTime);
+            for (size_t i=0;i<results.size();i++) {
+                const BenchResult &r = results[i];
+                fprintf(f, "    {\"name\": \"%s\", \"size\": %u, \"ops\": %llu, \"ns_per_op\": %.4f, \"min_ns_per_op\": %.4f, \"ops_per_sec\": %.6g}%s\n",
+                    r.name.c_str(), r.size, r.ops, r.nsPerOp, r.minNsPerOp, r.opsPerSecond, (i + 1 < results.size()) ? "," : "");
+            }
+            fprintf(f, "  ]\n}\n");
+            fclose(f);
+            return true;
+        }
+    private:
+        template <typename Body>
+        static double timeCalls(Body &body, unsigned long long calls)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (unsigned long long i=0;i<calls;i++) {
+                body();
+            }
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+};
+
+#endif // BENCH_H
@@ -0,0 +1,213 @@
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Bench.h"
+#include "Sprite.h"
+#include "ParticleBuffer.h"
+#include "SpatialHash.h"
+#include "Simulation.h"
+
+//microbenchmarks for the hot paths, build with the Bench target
+//  pong_bench [--filter NAME] [--json FILE] [--runs N] [--min-time SECONDS]
+
+using namespace std;
+
+//fixed-seed generator so every run measures the same inputs
+static unsigned int benchRandomState = 12345;
+static float randomFloat(float rmin, float rmax)
+{
+    benchRandomState ^= benchRandomState << 13;
+    benchRandomState ^= benchRandomState >> 17;
+    benchRandomState ^= benchRandomState << 5;
+    return rmin + (rmax - rmin)*(benchRandomState/4294967295.0f);
+}
+
+static vector<Sprite> randomSprites(unsigned int count)
+{
+    vector<Sprite> sprites;
+    for (unsigned int i=0;i<count;i++)
+    {
+        Sprite s(glm::vec2(randomFloat(10, 130), randomFloat(10, 130)), glm::vec2(randomFloat(0, 800), randomFloat(0, 600)));
+        s.rotation = randomFloat(0, 6.28f);
+        sprites.push_back(s);
+    }
+    return sprites;
+}
+
+static vector<RSprite> randomCircles(unsigned int count)
+{
+    vector<RSprite> circles;
+    for (unsigned int i=0;i<count;i++)
+    {
+        circles.push_back(RSprite(randomFloat(5, 60), glm::vec2(randomFloat(0, 800), randomFloat(0, 600))));
+    }
+    return circles;
+}
+
+void benchCollision(Bench &bench, unsigned int size)
+{
+    vector<Sprite> boxes = randomSprites(size), others = randomSprites(size);
+    vector<RSprite> circles = randomCircles(size);
+
+    bench.run("checkCollision/aabb-aabb", size, [&]() {
+        unsigned int hits = 0;
+        for (unsigned int i=0;i<size;i++)
+            hits += checkCollision(boxes[i], others[i]);
+        doNotOptimize(hits);
+    });
+    bench.run("checkCollision/aabb-circle", size, [&]() {
+        unsigned int hits = 0;
+        for (unsigned int i=0;i<size;i++)
+            hits += checkCollision(boxes[i], circles[i]);
+        doNotOptimize(hits);
+    });
+
+    vector<glm::vec2> motions;
+    for (unsigned int i=0;i<size;i++)
+        motions.push_back(glm::vec2(randomFloat(-300, 300), randomFloat(-300, 300)));
+    bench.run("sweepCircleAABB", size, [&]() { //what the ball runs against the paddle every tick
+        unsigned int hits = 0;
+        for (unsigned int i=0;i<size;i++)
+            hits += sweepCircleAABB(circles[i].position + circles[i].radius, circles[i].radius, motions[i], boxes[i]).hit;
+        doNotOptimize(hits);
+    });
+}
+
+void benchTransforms(Bench &bench, unsigned int size)
+{
+    vector<Sprite> sprites = randomSprites(size);
+    vector<glm::mat4> out(size);
+
+    bench.run("Sprite::toMat4", size, [&]() {
+        for (unsigned int i=0;i<size;i++)
+            out[i] = sprites[i].toMat4();
+        doNotOptimize(out[0]);
+    });
+    bench.run("Sprite::modelMatrix", size, [&]() { //what SpriteRenderer builds for every sprite
+        for (unsigned int i=0;i<size;i++)
+            out[i] = sprites[i].modelMatrix();
+        doNotOptimize(out[0]);
+    });
+}
+
+void benchParticles(Bench &bench, unsigned int size)
+{
+    ParticleBuffer particles(size, 3.0, glm::vec2(400, 300), glm::vec2(600, 400));
+    const float dt = 1.0f/120.0f;
+    const glm::vec2 ballVel(600, 400);
+
+    bench.run("ParticleBuffer::update", size, [&]() {
+        particles.update(dt, ballVel);
+        doNotOptimize(particles.posX[0]);
+    });
+    bench.run("ParticleBuffer::updateScalar", size, [&]() {
+        particles.updateScalar(dt, ballVel);
+        doNotOptimize(particles.posX[0]);
+    });
+#if defined(__SSE2__) || defined(_M_X64)
+    bench.run("ParticleBuffer::updateSSE", size, [&]() {
+        particles.updateSSE(dt, ballVel);
+        doNotOptimize(particles.posX[0]);
+    });
+#endif
+#if defined(__AVX__)
+    bench.run("ParticleBuffer::updateAVX", size, [&]() {
+        particles.updateAVX(dt, ballVel);
+        doNotOptimize(particles.posX[0]);
+    });
+#endif
+}
+
+//multi-ball scaling, reported per ball so linear scaling shows up as a flat ns/op.
+//The court grows with the ball count to keep the crowding the same at every size
+void benchBroadphase(Bench &bench, unsigned int balls)
+{
+    const float diameter = 10.0f;
+    float side = diameter*sqrt((float)balls)*4.0f;
+    vector<RSprite> circles;
+    for (unsigned int i=0;i<balls;i++)
+        circles.push_back(RSprite(0.5f*diameter, glm::vec2(randomFloat(0, side), randomFloat(0, side))));
+
+    SpatialHash grid(2.0f*diameter);
+    vector<CandidatePair> pairs;
+    bench.run("SpatialHash::findPairs", balls, [&]() { //rebuilt from scratch, like every tick
+        grid.clear();
+        for (unsigned int i=0;i<balls;i++)
+            grid.insert(i, circles[i]);
+        grid.findPairs(pairs);
+        doNotOptimize(pairs.size());
+    });
+    if (balls <= 10000) //O(n^2), past this it takes minutes
+    {
+        bench.run("checkCollision/all-pairs", balls, [&]() {
+            unsigned int hits = 0;
+            for (unsigned int i=0;i<balls;i++)
+                for (unsigned int j=i + 1;j<balls;j++)
+                    hits += checkCollision(circles[i], circles[j]);
+            doNotOptimize(hits);
+        });
+    }
+
+    Simulation sim((int)side + 100, (int)side);
+    sim.reset(1);
+    sim.addBalls(balls, diameter);
+    bench.run("Simulation::step/multiball", balls, [&]() {
+        sim.lost = false; //the extras can knock the main ball out, keep the match going
+        sim.step(SimInput(), 1.0f/120.0f);
+        doNotOptimize(sim.ballContacts);
+    });
+}
+
+int main(int argc, char* argv[])
+{
+    Bench bench;
+    const char *jsonPath = NULL;
+    for (int i=1;i<argc;i++) //read the command line
+    {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            bench.filter = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            bench.runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            bench.minTime = atof(argv[++i]);
+        } else {
+            cout << "usage: pong_bench [--filter NAME] [--json FILE] [--runs N] [--min-time SECONDS]" << endl;
+            return 1;
+        }
+    }
+    if (bench.runs == 0)
+    {
+        bench.runs = 1;
+    }
+
+    //sizes from a few objects (all in L1) up to well past the caches
+    unsigned int sizes[] = {16, 1024, 65536, 1048576};
+    bench.printHeader();
+    for (unsigned int s=0;s<sizeof(sizes)/sizeof(sizes[0]);s++)
+    {
+        benchCollision(bench, sizes[s]);
+        benchTransforms(bench, sizes[s]);
+        benchParticles(bench, sizes[s]);
+    }
+    unsigned int ballCounts[] = {10, 100, 1000, 10000, 100000};
+    for (unsigned int s=0;s<sizeof(ballCounts)/sizeof(ballCounts[0]);s++)
+    {
+        benchBroadphase(bench, ballCounts[s]);
+    }
+
+    if (jsonPath)
+    {
+        if (!bench.writeJSON(jsonPath))
+        {
+            cout << "Couldn't write " << jsonPath << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,395 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "Simulation.h"
+#include "MatchEngine.h"
+#include "Replay.h"
+#include "RollbackSession.h"
+#include "SpectatorServer.h"
+
+//runs matches with no window or GL context, for CI boxes and throughput checks
+
+using namespace std;
+
+//only chases the ball once it's coming back, so it can actually lose
+SimInput waitForBall(const Simulation &sim)
+{
+    if (sim.ballVel.x > 0.0f)
+    {
+        return SimInput();
+    }
+    return trackBall(sim);
+}
+
+//re-simulates a recording as fast as it goes, checking every checksum in it
+int playReplay(const string &path)
+{
+    ReplayReader replay;
+    if (!replay.open(path))
+        return 1;
+    Simulation sim;
+    sim.reset(replay.header.seed);
+    sim.addBalls(replay.header.extraBalls);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    SimInput input;
+    unsigned long long played = 0;
+    while (replay.next(input))
+    {
+        sim.step(input, replay.header.dt);
+        played++;
+        if (!replay.verify(sim))
+        {
+            cout << "Replay diverged at tick " << replay.mismatchTick << endl;
+            break;
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double gameSeconds = played*replay.header.dt;
+    cout << played << " ticks (" << gameSeconds << " s of play) in " << seconds << " s, "
+        << gameSeconds/seconds << "x real time, " << replay.checksumsChecked << " checksums checked" << endl;
+    return (replay.mismatchTick != 0) ? 1 : 0;
+}
+
+struct NetTest {
+    unsigned short port = 7777;
+    unsigned long long ticks = 0;
+    float dt = 0.0;
+    unsigned int seed = 1, balls = 0;
+    float latency = 0.0, jitter = 0.0, loss = 0.0; //the shim, on both sides
+    unsigned long long desyncTick = 0; //nudge player 2's ball here to see the host's state fix it
+};
+
+//one side of --net-test, ticking in real time with trackBall on its own paddle like a player would
+void runPeer(RollbackSession &session, Simulation &sim, const NetTest &test, bool &ok)
+{
+    session.link.latency = test.latency;
+    session.link.jitter = test.jitter;
+    session.link.loss = test.loss;
+    ok = (session.player == 0) ? session.host(test.port, test.seed, test.dt, test.balls, 10.0) :
+        session.join("127.0.0.1", test.port, 10.0);
+    if (!ok)
+        return;
+    session.start(sim);
+
+    double next = UdpLink::now();
+    double deadline = next + test.ticks*test.dt*10.0 + 10.0; //gives up if the other side went away
+    bool nudged = false;
+    while (sim.tick < test.ticks && UdpLink::now() < deadline)
+    {
+        SimInput input = trackBall(sim, (session.player == 0) ? sim.paddle : sim.paddle2);
+        SimEvents events;
+        session.advance(input, events);
+        if (session.player == 1 && test.desyncTick != 0 && sim.tick == test.desyncTick && !nudged)
+        {
+            sim.ball.position.x += 1.0f;
+            nudged = true;
+        }
+        session.endFrame(); //a frame is a tick here
+        next += test.dt;
+        this_thread::sleep_for(chrono::duration<double>(next - UdpLink::now()));
+    }
+    //both sides need every input up to the last tick before the states can match. The peer
+    //acking ours can get lost too, so after a second of resending assume ours got there
+    double grace = 0.0;
+    while (UdpLink::now() < deadline)
+    {
+        if (session.confirmedTick() >= test.ticks)
+        {
+            if (grace == 0.0)
+                grace = UdpLink::now() + 1.0;
+            if (session.ackedTick() >= test.ticks || UdpLink::now() > grace)
+                break;
+        }
+        session.idle();
+        this_thread::sleep_for(chrono::duration<double>(test.dt));
+    }
+    ok = (sim.tick == test.ticks && session.confirmedTick() >= test.ticks);
+}
+
+void printSession(const char *name, const RollbackSession &session)
+{
+    cout << name << ": " << session.rollbacks << " rollbacks, " << session.resimTicks << " ticks re-simulated ("
+        << (session.rollbacks ? (double)session.resimTicks/session.rollbacks : 0.0) << " deep on average, " << session.maxDepth << " at most)" << endl;
+    cout << "  re-simulation " << session.resimMs << " ms in all, " << session.maxResimMs << " ms at most in a frame, "
+        << session.overBudget << " frames over a tick" << endl;
+    cout << "  " << session.stalls << " ticks stalled, " << session.waits << " waited, "
+        << session.link.sent << " packets sent, " << session.link.dropped << " dropped by the shim" << endl;
+    if (session.statesSent > 0)
+    {
+        cout << "  " << session.statesSent << " states sent, " << session.stateBytes << " bytes ("
+            << session.fullStateBytes << " without deltas)" << endl;
+    }
+    if (session.statesReceived > 0)
+        cout << "  " << session.statesReceived << " states received, " << session.desyncs << " desyncs fixed" << endl;
+}
+
+//both players of a networked match in one process, over localhost
+int netTest(const NetTest &test)
+{
+    RollbackSession host, client;
+    host.player = 0;
+    client.player = 1;
+    Simulation hostSim, clientSim;
+    bool hostOk = false, clientOk = false;
+    thread hostThread(runPeer, ref(host), ref(hostSim), cref(test), ref(hostOk));
+    this_thread::sleep_for(chrono::milliseconds(50)); //let it bind first
+    runPeer(client, clientSim, test, clientOk);
+    hostThread.join();
+    if (!hostOk || !clientOk)
+    {
+        cout << "The match didn't finish" << endl;
+        return 1;
+    }
+
+    printSession("host", host);
+    printSession("client", client);
+    unsigned long long hostHash = hostSim.checksum(), clientHash = clientSim.checksum();
+    cout << test.ticks << " ticks, " << (hostHash == clientHash ? "states match" : "STATES DIFFER") << endl;
+    return (hostHash == clientHash) ? 0 : 1;
+}
+
+//plays matches in real time and streams every tick to spectators, something for
+//pong_spectate_load to connect to
+int serveMatches(SpectatorServer &server, unsigned long long ticks, float dt, unsigned int seed, unsigned int balls, Controller controller)
+{
+    if (!server.start())
+        return 1;
+    Simulation sim;
+    sim.reset(seed);
+    sim.addBalls(balls);
+    unsigned long long played = 1;
+    float shakeTime = 0.0; //like the game's
+    double next = SpectatorServer::now();
+    double report = next + 5.0;
+    for (unsigned long long i=0;i<ticks;i++)
+    {
+        if (shakeTime > 0.0f)
+            shakeTime -= dt;
+        SimEvents result = sim.step(controller(sim), dt);
+        if (result.paddleHit)
+            shakeTime = 0.07f;
+        server.broadcast(makeSpectatorFrame(sim, (shakeTime > 0.0f) ? SPECTATE_SHAKE : 0));
+        if (sim.lost)
+        {
+            sim.reset(seed + played);
+            sim.addBalls(balls);
+            played++;
+        }
+
+        next += dt;
+        double time = SpectatorServer::now();
+        if (time >= report)
+        {
+            cout << server.clients << " spectators, " << server.framesSent << " frames sent, "
+                << server.framesDropped << " dropped, " << server.kicked << " disconnected for stalling" << endl;
+            report += 5.0;
+        }
+        this_thread::sleep_for(chrono::duration<double>(next - time));
+    }
+    server.stop();
+    return 0;
+}
+
+void printReport(const EngineReport &report)
+{
+    cout << report.threads << " threads: " << report.matches << " matches (" << report.lost << " lost), "
+        << report.ticks << " ticks, " << report.steals << " steals in " << report.seconds << " s" << endl;
+    cout << "  " << report.matchesPerSecond << " matches/s, " << report.ticksPerSecond << " ticks/s, "
+        << report.ticksPerSecondPerCore << " ticks/s per core" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned long long ticks = 10000000; //defaults
+    float tickRate = 120.0;
+    unsigned int seed = 1;
+    unsigned int matches = 0; //0 runs one long single-threaded stream of matches
+    unsigned int threads = 0;
+    bool scaling = false;
+    unsigned int balls = 0; //extra balls for multi-ball, single stream only
+    Controller controller = trackBall;
+    string recordPath; //record the first match of the single stream
+    string replayPath;
+    unsigned int checksumInterval = 120;
+    bool net = false;
+    NetTest test;
+    unsigned short spectatePort = 0;
+    string spectateSocket;
+    for (int i=1;i<argc;i++) //read the command line
+    {
+        if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc)
+        {
+            ticks = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc) {
+            tickRate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--matches") == 0 && i + 1 < argc) {
+            matches = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--balls") == 0 && i + 1 < argc) {
+            balls = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--scaling") == 0) {
+            scaling = true;
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--checksum-interval") == 0 && i + 1 < argc) {
+            checksumInterval = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--spectate-port") == 0 && i + 1 < argc) {
+            spectatePort = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--spectate-socket") == 0 && i + 1 < argc) {
+            spectateSocket = argv[++i];
+        } else if (strcmp(argv[i], "--net-test") == 0) {
+            net = true;
+        } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            test.port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--net-latency") == 0 && i + 1 < argc) {
+            test.latency = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--net-jitter") == 0 && i + 1 < argc) {
+            test.jitter = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--net-loss") == 0 && i + 1 < argc) {
+            test.loss = atof(argv[++i])/100.0f;
+        } else if (strcmp(argv[i], "--net-desync") == 0 && i + 1 < argc) {
+            test.desyncTick = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--controller") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "track") == 0)
+            {
+                controller = trackBall;
+            } else if (strcmp(argv[i], "wait") == 0) {
+                controller = waitForBall;
+            } else {
+                cout << "Unknown controller " << argv[i] << endl;
+                return 1;
+            }
+        } else {
+            cout << "usage: pong_headless [--ticks N] [--tick-rate HZ] [--seed S] [--controller track|wait] [--balls N]" << endl;
+            cout << "                     [--matches N [--threads T] [--scaling]]" << endl;
+            cout << "                     [--record FILE [--checksum-interval N]] [--replay FILE]" << endl;
+            cout << "                     [--net-test [--port P] [--net-latency MS] [--net-jitter MS] [--net-loss PCT] [--net-desync TICK]]" << endl;
+            cout << "                     [--spectate-port P] [--spectate-socket PATH]" << endl;
+            return 1;
+        }
+    }
+    if (tickRate <= 0.0)
+    {
+        cout << "Invalid tick rate" << endl;
+        return 1;
+    }
+    float dt = 1.0f/tickRate;
+    if (!replayPath.empty())
+    {
+        return playReplay(replayPath);
+    }
+    if (spectatePort != 0 || !spectateSocket.empty()) //real time too
+    {
+        SpectatorServer server;
+        if ((spectatePort != 0 && !server.listenTcp(spectatePort)) || (!spectateSocket.empty() && !server.listenUnix(spectateSocket)))
+            return 1;
+        return serveMatches(server, ticks, dt, seed, balls, controller);
+    }
+    if (net) //in real time, so --ticks should be a few seconds' worth
+    {
+        test.ticks = std::min(ticks, 3600ULL);
+        test.dt = dt;
+        test.seed = seed;
+        test.balls = balls;
+        return netTest(test);
+    }
+
+    if (matches > 0) //batch of independent matches on the engine
+    {
+        vector<unsigned int> seeds(matches);
+        for (unsigned int i=0;i<matches;i++)
+        {
+            seeds[i] = seed + i;
+        }
+        MatchEngine engine(threads);
+        engine.controller = controller;
+        engine.dt = dt;
+        if (scaling) //same batch on 1, 2, 4... threads up to the requested count
+        {
+            unsigned int maxThreads = engine.threadCount;
+            double baseline = 0.0;
+            for (unsigned int t=1;t<=maxThreads;t = (t*2 > maxThreads && t < maxThreads) ? maxThreads : t*2)
+            {
+                MatchEngine scaled(t);
+                scaled.controller = controller;
+                scaled.dt = dt;
+                EngineReport report = scaled.run(seeds);
+                printReport(report);
+                if (t == 1)
+                {
+                    baseline = report.ticksPerSecond;
+                }
+                cout << "  speedup " << report.ticksPerSecond/baseline << "x, efficiency "
+                    << 100.0*report.ticksPerSecond/(baseline*t) << "%" << endl;
+            }
+        } else {
+            printReport(engine.run(seeds));
+        }
+        return 0;
+    }
+
+    Simulation sim;
+    sim.reset(seed);
+    sim.addBalls(balls);
+    unsigned long long played = 1;
+    unsigned long long hits = 0;
+    ReplayWriter recorder;
+    if (!recordPath.empty() && !recorder.open(recordPath, seed, dt, balls, checksumInterval))
+    {
+        cout << "Couldn't write " << recordPath << endl;
+        return 1;
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (unsigned long long i=0;i<ticks;i++)
+    {
+        SimInput input = quantizeInput(controller(sim)); //as it would be recorded
+        SimEvents result = sim.step(input, dt);
+        recorder.record(input, sim);
+        if (result.paddleHit)
+        {
+            hits++;
+        }
+        if (sim.lost && recorder.isOpen()) //a recording holds one match
+        {
+            ticks = i + 1;
+            break;
+        }
+        if (sim.lost) //next match gets the next seed
+        {
+            sim.reset(seed + played);
+            sim.addBalls(balls);
+            played++;
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << ticks << " ticks, " << played << " matches, " << hits << " paddle hits" << endl;
+    if (balls > 0)
+    {
+        cout << balls << " extra balls, " << sim.ballPairs.size() << " broadphase pairs and "
+            << sim.ballContacts << " contacts on the last tick" << endl;
+    }
+    cout << seconds << " s, " << (ticks/seconds) << " ticks/s" << endl;
+    if (recorder.isOpen())
+    {
+        if (!recorder.close())
+        {
+            cout << "Couldn't write " << recordPath << endl;
+            return 1;
+        }
+        cout << "recorded to " << recordPath << endl;
+    }
+    return 0;
+}
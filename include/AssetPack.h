@@ -0,0 +1,77 @@
+#ifndef ASSETPACK_H
+#define ASSETPACK_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//one file holding every asset, baked by the packer tool (tools/packer.cpp).
+//At runtime it's memory mapped and assets are used in place: texture pixels
+//go straight from the mapping to glTexImage2D, nothing is decoded or copied.
+//
+//layout: PackHeader, then entryCount PackEntry records (the index), then the
+//data of each entry, every one starting on a DATA_ALIGNMENT boundary
+
+enum AssetType {
+    ASSET_TEXTURE = 1, //pixels ready for GL, see PackEntry::format
+    ASSET_SHADER = 2, //GLSL source, null terminated so it can be passed as is
+    ASSET_DATA = 3 //anything else (levels...), raw bytes
+};
+
+struct PackHeader {
+    char magic[4]; //"PPAK"
+    unsigned int version;
+    unsigned int entryCount;
+    unsigned int reserved;
+};
+
+struct PackEntry {
+    char name[48]; //path it was baked from, forward slashes, null terminated
+    unsigned int type; //AssetType
+    unsigned int format; //for textures, the GL format of the pixels (GL_RGBA for RGBA8)
+    unsigned int width, height; //for textures
+    unsigned long long offset; //from the start of the file
+    unsigned long long size; //in bytes
+};
+
+class AssetPack
+{
+    public:
+        static const unsigned int VERSION = 1;
+        static const unsigned int DATA_ALIGNMENT = 16;
+
+        AssetPack();
+        ~AssetPack();
+
+        bool open(const std::string &path); //maps the file and checks the index, prints why if it can't
+        void close();
+        bool isOpen() const;
+
+        const PackEntry *find(const char *name) const; //NULL if it isn't in the pack
+        const unsigned char *data(const PackEntry &entry) const; //points into the mapping
+        unsigned int entryCount() const;
+        const PackEntry &entry(unsigned int index) const;
+    protected:
+        const unsigned char *base = nullptr;
+        size_t length = 0;
+        const PackEntry *entries = nullptr;
+        unsigned int count = 0;
+#ifdef _WIN32
+        void *fileHandle = nullptr;
+        void *mappingHandle = nullptr;
+#endif
+};
+
+//builds a pack in memory and writes it out, used by the packer tool
+class AssetPackWriter
+{
+    public:
+        bool add(const std::string &name, AssetType type, const void *bytes, size_t size,
+                 unsigned int format = 0, unsigned int width = 0, unsigned int height = 0);
+        bool write(const std::string &path) const;
+    protected:
+        std::vector<PackEntry> entries; //offsets are relative to the data block until written
+        std::vector<unsigned char> blob;
+};
+
+#endif // ASSETPACK_H
@@ -0,0 +1,24 @@
+#ifndef FIXEDTIMESTEP_H
+#define FIXEDTIMESTEP_H
+
+//accumulates real frame time and hands it out as fixed simulation ticks
+class FixedTimestep
+{
+    public:
+        FixedTimestep(float tickRate = 120.0, unsigned int maxSteps = 5);
+
+        float tickRate; //ticks per second
+        float dt; //length of one tick in seconds
+        unsigned int maxSteps; //most ticks run in one frame, extra time is dropped
+
+        double accumulator = 0.0; //time not yet simulated
+        unsigned long long tickCount = 0;
+        unsigned long long frameCount = 0;
+        unsigned long long droppedTicks = 0; //ticks skipped because a frame hit maxSteps
+
+        void setTickRate(float rate);
+        unsigned int advance(float frameTime); //returns how many ticks to run this frame
+        float alpha() const; //how far we are between the last tick and the next one, 0 to 1
+};
+
+#endif // FIXEDTIMESTEP_H
@@ -0,0 +1,69 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <GL/glew.h>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//records what reaches the window without stalling the frame: glReadPixels goes into a
+//ring of pixel buffer objects, so it returns straight away, and a fence tells us when
+//the copy has landed a frame or two later. Finished frames are copied out and handed
+//to a writer thread that does the file work. If the ring or the writer fall behind,
+//frames are dropped rather than waited for
+class FrameCapture
+{
+    public:
+        enum Format {
+            CAPTURE_PNG, //DIRECTORY/frame_000000.png...
+            CAPTURE_RAW //one DIRECTORY/capture_WxH.rgba file, frames back to back, top row first
+        };
+
+        FrameCapture(int width, int height, const std::string &directory, Format format = CAPTURE_PNG, unsigned int ringSize = 3);
+        ~FrameCapture();
+
+        //GL thread, once the frame is in the default framebuffer and before it's displayed
+        void capture();
+        //GL thread, waits for the frames in flight and for the writer to put everything on disk
+        void finish();
+
+        unsigned int maxQueued = 16; //frames waiting for the writer before new ones are dropped
+        unsigned long long captured = 0; //read back into the ring
+        unsigned long long dropped = 0; //skipped because the ring or the writer were full
+        unsigned long long written = 0; //guarded by lock
+    protected:
+        struct Slot {
+            GLuint pbo = 0;
+            GLsync fence = 0; //set while a copy is in flight
+            unsigned long long number = 0;
+        };
+        struct Frame {
+            unsigned long long number;
+            std::vector<unsigned char> pixels; //RGBA, bottom row first as GL reads them
+        };
+
+        int width, height;
+        std::string directory;
+        Format format;
+        std::vector<Slot> ring;
+        unsigned int next = 0; //slot for the next read, also the oldest one in flight
+        unsigned long long frameNumber = 0;
+
+        std::thread writer;
+        std::mutex lock;
+        std::condition_variable wake;
+        bool stopping = false; //guarded by lock
+        std::deque<Frame*> queue; //guarded by lock
+        std::vector<Frame*> spare; //guarded by lock, recycled so steady capture doesn't allocate
+        FILE *raw = NULL; //writer thread
+
+        void collect(bool wait); //moves finished copies to the writer, oldest first
+        void writeLoop();
+        bool writeFrame(const Frame &frame);
+};
+
+#endif // FRAMECAPTURE_H
@@ -0,0 +1,30 @@
+#ifndef FRAMEUNIFORMS_H
+#define FRAMEUNIFORMS_H
+
+#include <glm/glm.hpp>
+#include <GL/glew.h>
+
+//the "Frame" uniform block, laid out to match std140 in the shaders:
+//layout(std140) uniform Frame { mat4 proj; float time; };
+struct FrameData {
+    glm::mat4 proj;
+    GLfloat time = 0.0;
+    GLfloat padding[3]; //std140 rounds the block up to a whole vec4
+};
+
+//per-frame data shared by every program through one uniform buffer
+class FrameUniforms
+{
+    public:
+        static const GLuint BINDING = 0; //binding point the "Frame" block is attached to
+
+        FrameUniforms();
+        ~FrameUniforms();
+
+        GLuint ubo;
+        FrameData data;
+
+        void upload(); //send data to the GPU, call once per frame
+};
+
+#endif // FRAMEUNIFORMS_H
@@ -0,0 +1,47 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <GL/glew.h>
+
+//remembers what's bound so setting the same thing again doesn't reach the driver.
+//Everything that binds programs, VAOs, 2D textures or framebuffers, or sets the
+//clear color or blending, has to go through here or the cache goes stale
+//(call invalidate() after anything that doesn't)
+
+class GLState
+{
+    public:
+        static GLState& get();
+        static const unsigned int TEXTURE_UNITS = 8;
+
+        void useProgram(GLuint program);
+        void bindVertexArray(GLuint vao);
+        void activeTexture(unsigned int unit); //0 for GL_TEXTURE0...
+        void bindTexture(GLuint texture); //GL_TEXTURE_2D on the active unit
+        void bindTexture(unsigned int unit, GLuint texture);
+        void bindFramebuffer(GLuint fbo);
+        void clearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a);
+        void setBlend(bool enabled);
+        void blendFunc(GLenum src, GLenum dst);
+
+        //forget everything, the next call of each kind always goes through.
+        //Needed when objects are deleted, since GL hands their names out again
+        void invalidate();
+        void endFrame(); //moves this frame's counts to the last* ones
+
+        unsigned int skipped = 0, issued = 0; //calls so far this frame
+        unsigned int lastSkipped = 0, lastIssued = 0; //for the whole of last frame
+    private:
+        GLState();
+
+        GLuint program, vao, fbo;
+        unsigned int unit;
+        GLuint textures[TEXTURE_UNITS];
+        GLfloat clear[4];
+        int blend; //-1 unknown
+        GLenum blendSrc, blendDst;
+
+        bool changed(bool differs); //counts the call either way
+};
+
+#endif // GLSTATE_H
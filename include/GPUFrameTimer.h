@@ -0,0 +1,38 @@
+#ifndef GPUFRAMETIMER_H
+#define GPUFRAMETIMER_H
+
+#include <GL/glew.h>
+
+//how long the GPU spent on a span of each frame, read back a few frames later so
+//nothing waits on it. Always on, unlike the profiler, since the resolution scaler
+//runs on it. Uses a pair of timestamps rather than GL_TIME_ELAPSED, which can't
+//overlap the profiler's own timers
+class GPUFrameTimer
+{
+    public:
+        static const unsigned int LATENCY = 4; //frames before a result is read back
+
+        GPUFrameTimer();
+        ~GPUFrameTimer();
+
+        //GL thread, once per frame around the work to time
+        void begin();
+        void end();
+
+        //milliseconds, true once per new result (none while they're still in flight)
+        bool result(float &ms);
+    protected:
+        struct Slot {
+            GLuint queries[2]; //begin, end
+            bool pending = false;
+        };
+        Slot ring[LATENCY];
+        unsigned int next = 0;
+        bool ready = false; //queries made, needs the context so it's done on first use
+        float latest = 0.0;
+        bool fresh = false;
+
+        void read(Slot &slot);
+};
+
+#endif // GPUFRAMETIMER_H
@@ -0,0 +1,51 @@
+#ifndef GPUPARTICLESYSTEM_H
+#define GPUPARTICLESYSTEM_H
+
+#include <glm/glm.hpp>
+#include <GL/glew.h>
+#include "Shader.h"
+
+//particle system that lives entirely in buffer objects: the update runs in a
+//vertex shader captured with transform feedback, and drawing is one GL_POINTS
+//call expanded to quads by a geometry shader. The CPU only sets emitter uniforms.
+class GPUParticleSystem
+{
+    public:
+        //updateShader must be compiled with CompileFeedback using VARYINGS
+        GPUParticleSystem(Shader updateShader, Shader renderShader, unsigned int particleNum, float lifeT);
+        ~GPUParticleSystem();
+
+        static const GLchar* VARYINGS[]; //outputs of the update shader, in buffer order
+        static const GLsizei VARYING_COUNT = 3;
+
+        glm::vec2 position; //emitter
+        glm::vec3 color = glm::vec3(0.0, 0.0, 1.0);
+        float size = 2.0; //half the width of a particle in pixels
+        unsigned int particleNum;
+        float particleLife; //particle lifetime in seconds
+
+        void update(float dt, glm::vec2 ballVel);
+        void render();
+    protected:
+        struct Particle { //layout of one particle in the buffers
+            glm::vec2 position;
+            glm::vec2 velocity;
+            float life;
+        };
+
+        Shader updateShader;
+        Shader renderShader;
+        GLuint vao[2];
+        GLuint vbo[2];
+        unsigned int current = 0; //buffer holding the latest state, the other one gets written next
+
+        Uniform<glm::vec2> emitterUniform;
+        Uniform<glm::vec2> ballVelUniform;
+        Uniform<GLfloat> dtUniform;
+        Uniform<GLfloat> lifetimeUniform;
+        Uniform<GLfloat> renderLifetimeUniform;
+        Uniform<GLfloat> sizeUniform;
+        Uniform<glm::vec3> colorUniform;
+};
+
+#endif // GPUPARTICLESYSTEM_H
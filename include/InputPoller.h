@@ -0,0 +1,41 @@
+#ifndef INPUTPOLLER_H
+#define INPUTPOLLER_H
+
+#include <atomic>
+#include <thread>
+#include <SFML/Window.hpp>
+#include "SpscRing.h"
+
+//an input event and when it happened, in InputPoller::now() seconds
+struct TimedEvent {
+    double time = 0.0;
+    sf::Event event;
+};
+
+typedef SpscRing<TimedEvent, 1024> EventRing;
+
+//samples the paddle keys on its own thread, much faster than frames or ticks run,
+//and queues every press and release with its timestamp. The simulation reads the
+//queue and applies each change at the point inside the tick where it happened, so
+//a slow frame doesn't delay or swallow input
+class InputPoller
+{
+    public:
+        InputPoller();
+        ~InputPoller();
+
+        static double now(); //seconds on the clock every input timestamp uses
+
+        void start(float rate = 1000.0); //samples per second
+        void stop();
+
+        EventRing events; //key presses and releases, the poll thread is the only producer
+        sf::Keyboard::Key keys[2]; //what's sampled, Up and Down
+    protected:
+        std::thread thread;
+        std::atomic<bool> running;
+
+        void pollLoop(float rate);
+};
+
+#endif // INPUTPOLLER_H
@@ -0,0 +1,71 @@
+#ifndef MATCHENGINE_H
+#define MATCHENGINE_H
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "Simulation.h"
+
+//picks the paddle input for the next tick
+typedef SimInput (*Controller)(const Simulation &sim);
+
+struct MatchResult {
+    unsigned int seed = 0;
+    unsigned long long ticks = 0;
+    unsigned int hits = 0;
+    bool lost = false;
+};
+
+struct EngineReport {
+    unsigned int threads = 0;
+    double seconds = 0.0;
+    unsigned long long matches = 0;
+    unsigned long long ticks = 0;
+    unsigned long long hits = 0;
+    unsigned long long lost = 0;
+    unsigned long long steals = 0; //matches a worker took from another worker's queue
+    double matchesPerSecond = 0.0;
+    double ticksPerSecond = 0.0;
+    double ticksPerSecondPerCore = 0.0;
+};
+
+//runs many independent matches across worker threads, idle workers steal
+//matches from the queues of busy ones
+class MatchEngine
+{
+    public:
+        MatchEngine(unsigned int threads = 0); //0 uses every core
+
+        unsigned int threadCount;
+        Controller controller = trackBall;
+        float dt = 1.0f/120.0f;
+        unsigned long long maxTicks = 120*60; //a match nobody loses ends after a minute of game time
+
+        //plays one match per seed, results (if given) is filled in seed order
+        EngineReport run(const std::vector<unsigned int> &seeds, std::vector<MatchResult> *results = nullptr);
+    protected:
+        struct WorkQueue { //owner pops from the back, thieves take from the front
+            std::mutex lock;
+            std::deque<unsigned int> jobs;
+        };
+        struct Totals { //each worker adds its counts once, when it runs out of work
+            std::atomic<unsigned long long> matches;
+            std::atomic<unsigned long long> ticks;
+            std::atomic<unsigned long long> hits;
+            std::atomic<unsigned long long> lost;
+            std::atomic<unsigned long long> steals;
+        };
+
+        WorkQueue *queues = nullptr;
+        Totals totals;
+        const std::vector<unsigned int> *seeds = nullptr;
+        std::vector<MatchResult> *results = nullptr;
+
+        void worker(unsigned int index);
+        bool popJob(unsigned int index, unsigned int &job);
+        bool stealJob(unsigned int index, unsigned int &job);
+        MatchResult playMatch(unsigned int seed);
+};
+
+#endif // MATCHENGINE_H
@@ -0,0 +1,49 @@
+#ifndef PARTICLEBUFFER_H
+#define PARTICLEBUFFER_H
+
+#include <glm/glm.hpp>
+
+//particle state kept as one aligned array per field (structure of arrays),
+//so update() can work on 4 or 8 particles at once. No GL in here, the
+//ParticleSystem does the drawing.
+class ParticleBuffer
+{
+    public:
+        static const unsigned int ALIGNMENT = 32; //bytes, enough for AVX loads
+        static const unsigned int WIDTH = 8; //arrays are padded to a multiple of this many floats
+
+        ParticleBuffer(unsigned int count, float lifetime, glm::vec2 emitter, glm::vec2 velocity);
+        ~ParticleBuffer();
+
+        unsigned int count; //particles in use
+        unsigned int capacity; //count rounded up to WIDTH, the padding is updated but never drawn
+        float lifetime; //particle lifetime in seconds
+        glm::vec2 emitter; //where particles respawn
+
+        float *posX, *posY;
+        float *scaleX, *scaleY;
+        float *alpha;
+        float *life; //seconds left
+        float *colorR, *colorG, *colorB;
+        float *velX, *velY;
+
+        void reset(unsigned int index, glm::vec2 velocity);
+        void update(float dt, glm::vec2 ballVel); //uses the widest kernel this build supports
+
+        //the kernels themselves, public so they can be benchmarked against each other
+        void updateScalar(float dt, glm::vec2 ballVel);
+#if defined(__SSE2__) || defined(_M_X64)
+        void updateSSE(float dt, glm::vec2 ballVel);
+#endif
+#if defined(__AVX__)
+        void updateAVX(float dt, glm::vec2 ballVel);
+#endif
+        static const char* kernelName(); //name of the kernel update() uses
+    private:
+        float *storage; //every array lives in this one block
+        //no copies, the arrays would be shared
+        ParticleBuffer(const ParticleBuffer&);
+        ParticleBuffer& operator=(const ParticleBuffer&);
+};
+
+#endif // PARTICLEBUFFER_H
@@ -6,6 +6,7 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <GL/glew.h>
 #include "Shader.h"
+#include "ParticleBuffer.h"
 
 using namespace std;
 
@@ -14,31 +15,25 @@ using namespace std;
 class ParticleSystem
 {
     public:
-        ParticleSystem(glm::vec2 pos, Shader s, unsigned int particleNum, glm::mat4 proj, float lifeT, glm::vec2 ballVel);
+        ParticleSystem(glm::vec2 pos, Shader s, unsigned int particleNum, float lifeT, glm::vec2 ballVel);
         ~ParticleSystem();
         glm::vec2 position;
         Shader shader;
         GLuint vao;
         GLuint vbo;
-        glm::mat4 proj;
         unsigned int particleNum;
 
         float particleLife; //particle lifetime in seconds
 
-        struct Particle {
-            glm::vec2 position;
-            glm::vec2 scale;
-            float alpha = 1.0;
-            float lifetime;
-            glm::vec3 color;
-            glm::vec2 velocity;
-        };
-        Particle *particles;
+        ParticleBuffer particles; //one array per field, see ParticleBuffer.h
 
         void update(float dt, glm::vec2 ballVel);
         void render();
     protected:
-        void resetParticle(int index, glm::vec2 velocity);
+        Uniform<glm::mat4> modelUniform;
+        Uniform<GLfloat> alphaUniform;
+        Uniform<glm::vec3> colorUniform;
+
 };
 
 #endif // PARTICLESYSTEM_H
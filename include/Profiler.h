@@ -0,0 +1,107 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+//frame profiler: scoped CPU timers, GL timer queries, per-frame counters and
+//frame time percentiles, with Chrome trace export (open in chrome://tracing).
+//Everything here only exists when PONG_PROFILE is defined (the Debug target),
+//otherwise the macros expand to nothing.
+
+#ifdef PONG_PROFILE
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_BEGIN(name) Profiler::get().gpuBegin(name)
+#define PROFILE_GPU_END() Profiler::get().gpuEnd()
+#define PROFILE_COUNT(name, n) Profiler::get().count(name, n)
+#define PROFILE_FRAME() Profiler::get().endFrame()
+
+class Profiler
+{
+    public:
+        static const unsigned int HISTORY = 240; //frame times kept for the percentiles and overlay
+        static const unsigned int GPU_LATENCY = 4; //frames before a timer query is read back, so we never wait on it
+        static const unsigned int GPU_TIMERS = 16; //timer queries per frame
+        static const unsigned int MAX_EVENTS = 200000; //trace events kept, oldest are dropped
+
+        static Profiler& get();
+
+        bool overlay = false; //draw the frame time graph
+
+        unsigned long long now() const; //microseconds since the profiler started
+        void record(const char *name, unsigned long long start, unsigned long long duration);
+        //GL timers can't nest, only one may be open at a time
+        void gpuBegin(const char *name);
+        void gpuEnd();
+        void count(const char *name, long long n);
+        void endFrame();
+
+        float frameTime(unsigned int framesAgo) const; //milliseconds
+        float percentile(float p) const; //of the last HISTORY frame times, in milliseconds
+        float gpuTime(const char *name) const; //latest result for a GPU timer, in milliseconds
+        const std::map<std::string, long long>& counters() const { return lastCounters; } //from the last frame
+        bool exportTrace(const char *path);
+    private:
+        Profiler();
+
+        struct TraceEvent {
+            const char *name;
+            unsigned long long start;
+            unsigned long long duration;
+            unsigned int thread;
+        };
+        struct GpuTimer {
+            const char *name;
+            unsigned long long cpuStart; //when it was issued, for placing it in the trace
+        };
+
+        std::mutex lock; //scopes may be recorded from several threads
+        std::vector<TraceEvent> events; //ring of MAX_EVENTS
+        size_t nextEvent = 0;
+        std::map<unsigned long long, unsigned int> threadIds; //small ids for the trace
+
+        unsigned long long frameStart = 0;
+        unsigned long long frameCount = 0;
+        float history[HISTORY];
+
+        std::map<std::string, long long> frameCounters;
+        std::map<std::string, long long> lastCounters;
+
+        bool gpuReady = false;
+        GLuint queries[GPU_LATENCY][GPU_TIMERS];
+        GpuTimer timers[GPU_LATENCY][GPU_TIMERS];
+        unsigned int timersUsed[GPU_LATENCY];
+        std::map<std::string, float> gpuResults;
+
+        unsigned int threadId();
+        void readGpuTimers(unsigned int slot);
+};
+
+//times the enclosing scope
+class ProfileScope
+{
+    public:
+        ProfileScope(const char *name) : name(name), start(Profiler::get().now()) { }
+        ~ProfileScope() { Profiler::get().record(name, start, Profiler::get().now() - start); }
+    private:
+        const char *name;
+        unsigned long long start;
+};
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_GPU_BEGIN(name) ((void)0)
+#define PROFILE_GPU_END() ((void)0)
+#define PROFILE_COUNT(name, n) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+
+#endif // PONG_PROFILE
+
+#endif // PROFILER_H
@@ -0,0 +1,93 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstdio>
+#include <string>
+#include "Simulation.h"
+
+//recordings of one match: the seed and tick length, then the input of every tick,
+//so playing it back through Simulation::step gives the same match bit for bit.
+//
+//layout: ReplayHeader, then records. Runs of identical ticks are stored once
+//(REPLAY_INPUT) and a checksum of the simulation after every checksumInterval
+//ticks (REPLAY_CHECKSUM) lets playback spot the first tick that went differently
+
+enum ReplayRecordType {
+    REPLAY_INPUT = 1,
+    REPLAY_CHECKSUM = 2
+};
+
+struct ReplayHeader {
+    char magic[4]; //"PREP"
+    unsigned int version;
+    unsigned int seed;
+    float dt;
+    unsigned int extraBalls; //multi-ball
+    unsigned int checksumInterval;
+};
+
+struct ReplayInput { //8 bytes
+    unsigned char type; //REPLAY_INPUT
+    unsigned char flags; //INPUT_UP...
+    unsigned char upHeld, downHeld; //0 to 255 for 0 to 1
+    unsigned int ticks; //how many ticks in a row had this input
+};
+
+struct ReplayChecksum { //16 bytes
+    unsigned char type; //REPLAY_CHECKSUM
+    unsigned char reserved[3];
+    unsigned int tick; //Simulation::tick it was taken after
+    unsigned long long checksum;
+};
+
+//rounds the held fractions to what a recording can store, live input goes through
+//this too so a recorded match and its playback step with exactly the same numbers
+SimInput quantizeInput(const SimInput &input);
+
+class ReplayWriter
+{
+    public:
+        static const unsigned int VERSION = 1;
+        static const unsigned char INPUT_UP = 1, INPUT_DOWN = 2, INPUT_TOGGLE_COLOR = 4;
+
+        ~ReplayWriter();
+
+        bool open(const std::string &path, unsigned int seed, float dt, unsigned int extraBalls, unsigned int checksumInterval = 120);
+        void record(const SimInput &input, const Simulation &sim); //after each step, with the input it was given
+        bool close();
+        bool isOpen() const { return file != NULL; }
+    protected:
+        FILE *file = NULL;
+        unsigned int checksumInterval = 120;
+        ReplayInput run; //the run of ticks being built
+        bool ok = true;
+
+        void flushRun();
+};
+
+class ReplayReader
+{
+    public:
+        ~ReplayReader();
+
+        ReplayHeader header;
+
+        bool open(const std::string &path); //prints why if it can't
+        void close();
+        bool next(SimInput &input); //input for the next tick, false at the end of the recording
+        //after stepping with that input: false if the recording has a checksum for this
+        //tick and it doesn't match
+        bool verify(const Simulation &sim);
+
+        unsigned long long checksumsChecked = 0;
+        unsigned long long mismatchTick = 0; //first tick that didn't match, 0 if none did
+    protected:
+        FILE *file = NULL;
+        ReplayInput run;
+        ReplayChecksum pending; //next checksum in the file
+        bool hasPending = false;
+
+        bool readRecord(); //fills run or pending, false at the end
+};
+
+#endif // REPLAY_H
@@ -0,0 +1,30 @@
+#ifndef RESOLUTIONSCALER_H
+#define RESOLUTIONSCALER_H
+
+//picks a render scale from measured frame times: when frames run over the budget the
+//scale steps down, when there's plenty of headroom it steps back up. Decisions are made
+//on the average of a window of frames, and the window starts over after each change,
+//so one slow frame doesn't make it flap
+class ResolutionScaler
+{
+    public:
+        ResolutionScaler(float budget = 1000.0f/60.0f); //milliseconds per frame
+
+        float budget;
+        float minScale = 0.5;
+        float maxScale = 1.0;
+        float step = 0.1; //how much one decision changes the scale
+        float headroom = 0.75; //scale up only once frames take less than this much of the budget
+        unsigned int window = 30; //frames averaged per decision
+        bool enabled = true;
+
+        float scale = 1.0;
+        unsigned int changes = 0;
+
+        bool update(float frameTime); //frame time in milliseconds, true when the scale changed
+    protected:
+        float total = 0.0;
+        unsigned int frames = 0;
+};
+
+#endif // RESOLUTIONSCALER_H
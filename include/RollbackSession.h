@@ -0,0 +1,155 @@
+#ifndef ROLLBACKSESSION_H
+#define ROLLBACKSESSION_H
+
+#include <string>
+#include <vector>
+#include "Simulation.h"
+#include "UdpLink.h"
+
+//two-player matches over UDP with rollback.
+//Each side runs its own simulation and never waits for the other's input: a tick
+//the peer's input hasn't arrived for is stepped with a guess (whatever they were
+//doing last), and when the real input turns out different the simulation goes back
+//to a snapshot from before that tick and steps forward again. Only if the guesses
+//would reach further back than maxRollback ticks does the local side wait.
+//
+//Inputs go out with every tick, resending everything the peer hasn't acked, so a
+//lost packet costs nothing but a later correction. Every syncInterval ticks the
+//host also sends the confirmed state, XOR'd against the last one the client got
+//and run-length coded, and the client takes it over if its own differs (which a
+//deterministic simulation shouldn't, it's there to catch the case where it isn't)
+
+enum NetPacketType {
+    NET_HELLO = 1, //client asking to join, resent until it gets a NET_WELCOME
+    NET_WELCOME = 2, //host's match settings
+    NET_INPUT = 3,
+    NET_STATE = 4
+};
+
+struct NetHello {
+    unsigned char type; //NET_HELLO
+    unsigned char version;
+    unsigned char reserved[2];
+};
+
+struct NetWelcome {
+    unsigned char type; //NET_WELCOME
+    unsigned char version;
+    unsigned char reserved[2];
+    unsigned int seed;
+    float dt;
+    unsigned int extraBalls;
+};
+
+struct NetInputHeader { //followed by count inputs, NetInput each
+    unsigned char type; //NET_INPUT
+    unsigned char count;
+    signed char advantage; //sender's tick minus the newest tick it has our input for
+    unsigned char reserved;
+    unsigned int firstTick; //tick of the first input
+    unsigned int ack; //the sender has every input of ours up to this tick
+    unsigned int stateAck; //newest NET_STATE the sender got, 0 for none
+};
+
+struct NetInput { //one player's input for one tick
+    unsigned char flags; //ReplayWriter::INPUT_UP...
+    unsigned char upHeld, downHeld; //0 to 255 for 0 to 1
+};
+
+struct NetStateHeader { //followed by the encoded state
+    unsigned char type; //NET_STATE
+    unsigned char reserved[3];
+    unsigned int tick; //the state is the one after this tick
+    unsigned int baseTick; //0 for a full state, else it's XOR'd against the state sent for this tick
+    unsigned int words; //size of the decoded state, in 4 byte words
+};
+
+class RollbackSession
+{
+    public:
+        static const unsigned int VERSION = 1;
+        static const unsigned int HISTORY = 128; //ticks of inputs and snapshots kept, a power of two
+        static const unsigned int MAX_INPUTS = 64; //most inputs in one packet
+        static const unsigned int STATE_HISTORY = 8; //sent (or received) states kept as delta bases
+
+        RollbackSession();
+
+        UdpLink link; //set its shim before host() or join()
+        unsigned int maxRollback = 12; //ticks re-simulated at most, past this the local side waits
+        unsigned int syncInterval = 30; //the host sends the confirmed state this often, in ticks
+
+        //both block until the other side answers or timeout seconds pass, and print why they gave up.
+        //The host plays the left paddle and decides the match, the settings are copied from it
+        bool host(unsigned short port, unsigned int seed, float dt, unsigned int extraBalls, double timeout = 60.0);
+        bool join(const std::string &address, unsigned short port, double timeout = 60.0);
+        int player = 0; //0 hosts, 1 joined
+        unsigned int seed = 0;
+        float dt = 1.0f/120.0f;
+        unsigned int extraBalls = 0;
+
+        void start(Simulation &sim); //resets it into the agreed two-player match, the session steps it from now on
+        //steps the tick after sim.tick with the local player's input, false if it has to wait for the
+        //peer instead (events are only filled in when it stepped)
+        bool advance(const SimInput &input, SimEvents &events);
+        void poll(); //reads what the peer sent, rolling back if it has to. advance() does this too
+        void idle(); //poll() and resend, for when the local side has stopped stepping but the peer hasn't
+        unsigned long long confirmedTick() const { return remoteConfirmed; } //newest tick both inputs are in for
+        unsigned long long ackedTick() const { return peerAck; } //newest tick the peer has our input for
+        void endFrame(); //moves this frame's numbers to the last* ones
+
+        //since the last endFrame()
+        unsigned int frameDepth = 0; //deepest rollback, in ticks
+        unsigned int frameResimTicks = 0;
+        double frameResimMs = 0.0;
+        unsigned int lastDepth = 0, lastResimTicks = 0;
+        double lastResimMs = 0.0;
+
+        //whole session
+        unsigned long long rollbacks = 0, resimTicks = 0;
+        unsigned int maxDepth = 0;
+        double resimMs = 0.0, maxResimMs = 0.0; //maxResimMs is for one frame
+        unsigned long long overBudget = 0; //frames whose re-simulation took longer than a tick
+        unsigned long long stalls = 0; //ticks waited because the peer was maxRollback behind
+        unsigned long long waits = 0; //ticks waited to let a peer that's running behind catch up
+        unsigned long long statesSent = 0, statesReceived = 0, desyncs = 0;
+        unsigned long long stateBytes = 0, fullStateBytes = 0; //as sent, and what they'd be without deltas
+    protected:
+        Simulation *sim = nullptr;
+
+        NetInput local[HISTORY]; //by tick%HISTORY
+        NetInput remote[HISTORY]; //what the peer sent, valid up to remoteConfirmed
+        NetInput used[HISTORY]; //what the peer's paddle was stepped with, guess or not
+        SimSnapshot snapshots[HISTORY]; //the state before each tick
+        unsigned long long remoteConfirmed = 0; //every remote input up to here is in
+        unsigned long long remoteLatest = 0; //newest tick the peer has sent input for
+        unsigned long long peerAck = 0; //the peer has our inputs up to here
+        int remoteAdvantage = 0;
+        unsigned long long lastWait = 0;
+
+        struct SentState {
+            unsigned int tick = 0;
+            std::vector<unsigned int> words;
+        };
+        SentState states[STATE_HISTORY]; //host: sent, client: received, oldest gets replaced
+        unsigned int stateSlot = 0; //next one to replace
+        unsigned long long nextSync = 0; //host: next tick to send the state of
+        unsigned int stateAck = 0; //client: newest state received, host: newest the client acked
+        bool checkPending = false; //client: the state for stateAck hasn't been compared yet
+        std::vector<unsigned char> packet, incoming;
+        std::vector<unsigned int> scratch;
+        SimSnapshot live;
+
+        SimEvents stepTick(unsigned long long tick); //steps sim from tick - 1 to tick, saving the snapshot first
+        //puts sim back to before, the state before tick from, and steps it forward to where it was
+        void resimulate(unsigned long long from, const SimSnapshot &before);
+        NetInput predict() const; //the peer's input for a tick it hasn't sent yet
+        bool stateAfter(unsigned long long tick, std::vector<unsigned int> &words); //false if it's too old
+        void sendWelcome();
+        void sendInputs();
+        void sendState();
+        void receiveInputs(const unsigned char *data, int size, unsigned long long &firstWrong);
+        void receiveState(const unsigned char *data, int size);
+        void checkState();
+};
+
+#endif // ROLLBACKSESSION_H
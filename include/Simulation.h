@@ -0,0 +1,92 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Sprite.h"
+#include "SpatialHash.h"
+
+//the match logic on its own: no window, no GL, no SFML
+
+//what the player is doing during one tick
+struct SimInput {
+    bool up = false;
+    bool down = false;
+    //how much of the tick each key was held, 0 to 1, for input sampled faster than ticks
+    float upHeld = 1.0;
+    float downHeld = 1.0;
+    bool togglePaddleColor = false; //the player clicked the paddle
+};
+
+//what happened during one tick, so the front end can react (effects, sounds...)
+struct SimEvents {
+    bool paddleHit = false;
+    bool ballLost = false;
+};
+
+//the whole match at one tick, for rolling back and re-simulating.
+//Saving into the same snapshot again reuses its storage
+struct SimSnapshot {
+    SimSnapshot() : paddle(glm::vec2(0.0, 0.0)), paddle2(glm::vec2(0.0, 0.0)), ball(glm::vec2(0.0, 0.0)) {}
+
+    unsigned long long tick = 0;
+    unsigned int rngState = 0;
+    bool lost = false;
+    int loser = 0;
+    Sprite paddle, paddle2, ball;
+    glm::vec2 ballVel;
+    std::vector<Sprite> balls;
+    std::vector<glm::vec2> ballVels;
+};
+
+class Simulation
+{
+    public:
+        Simulation(int width = 800, int height = 600);
+
+        int width, height; //court bounds
+        float paddleSpeed = 450.0; //pixels per second
+        static const int MAX_BOUNCES = 4; //contacts resolved per tick before the ball gives up moving
+
+        Sprite paddle;
+        Sprite ball;
+        glm::vec2 ballVel;
+        bool lost = false;
+
+        //two-player mode: a second paddle guards the right wall, and letting the
+        //ball through there loses the match too
+        bool twoPlayer = false;
+        Sprite paddle2;
+        int loser = 0; //1 or 2 once lost, whose side the ball went out on
+
+        //multi-ball mode: extra balls that bounce off the walls, the paddle, each other and the ball,
+        //but never lose the match
+        std::vector<Sprite> balls;
+        std::vector<glm::vec2> ballVels;
+        SpatialHash broadphase;
+        std::vector<CandidatePair> ballPairs; //broadphase candidates from the last tick
+        unsigned int ballContacts = 0; //candidates that were really touching
+
+        unsigned long long tick = 0; //ticks since the last reset
+        unsigned int rngState; //the simulation has its own generator, so a seed replays the same match
+
+        void reset(unsigned int seed); //start a new match
+        SimEvents step(const SimInput &input, float dt); //advance one tick
+        SimEvents step(const SimInput &input, const SimInput &input2, float dt); //with player 2 as well
+        void addBalls(unsigned int count, float diameter = 20.0); //for multi-ball, reset() removes them
+        unsigned long long checksum() const; //hash of everything step() depends on, for spotting desyncs
+        void save(SimSnapshot &snapshot) const;
+        void restore(const SimSnapshot &snapshot); //the ball count has to match, addBalls() isn't undone
+    protected:
+        void movePaddle(Sprite &sprite, const SimInput &input, glm::vec3 color, float dt);
+        void moveBall(Sprite &ball, glm::vec2 &vel, float dt, bool mainBall, SimEvents &events);
+        void collideBalls();
+        unsigned int nextRandom();
+        int randUInt(int rmin, int rmax);
+};
+
+//simple controller that moves the paddle toward the ball
+SimInput trackBall(const Simulation &sim);
+SimInput trackBall(const Simulation &sim, const Sprite &paddle);
+
+#endif // SIMULATION_H
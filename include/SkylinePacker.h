@@ -0,0 +1,30 @@
+#ifndef SKYLINEPACKER_H
+#define SKYLINEPACKER_H
+
+#include <vector>
+
+//packs rectangles into a fixed size area with the skyline bottom-left heuristic:
+//the packed area is tracked as a list of horizontal segments (the skyline) and every
+//rectangle goes where its top ends up lowest. No GL, the atlas does the uploading
+
+class SkylinePacker
+{
+    public:
+        SkylinePacker(int width, int height);
+
+        int width, height;
+
+        bool pack(int w, int h, int &x, int &y); //false if there's no room left
+        void reset();
+        float occupancy() const; //fraction of the area handed out so far
+    protected:
+        struct Segment {
+            int x, y, width;
+        };
+        std::vector<Segment> skyline; //left to right, covering the whole width
+        long long usedArea = 0;
+
+        bool fits(unsigned int index, int w, int h, int &y) const;
+};
+
+#endif // SKYLINEPACKER_H
@@ -0,0 +1,50 @@
+#ifndef SPATIALHASH_H
+#define SPATIALHASH_H
+
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Sprite.h"
+
+//broadphase for lots of moving objects: bounds go into a hashed uniform grid,
+//and only objects sharing a cell are handed to the narrowphase (checkCollision).
+//It's rebuilt every tick, the storage is kept so that doesn't allocate once warmed up
+
+typedef std::pair<unsigned int, unsigned int> CandidatePair; //ids, first < second
+
+class SpatialHash
+{
+    public:
+        SpatialHash(float cellSize = 128.0);
+
+        float cellSize; //should be about the size of the biggest object
+
+        void clear(); //forget everything inserted, call at the start of each tick
+        void insert(unsigned int id, glm::vec2 boundsMin, glm::vec2 boundsMax);
+        void insert(unsigned int id, const Sprite &sprite);
+        void insert(unsigned int id, const RSprite &sprite);
+
+        //every pair whose bounds overlap, each reported once, in a deterministic order
+        void findPairs(std::vector<CandidatePair> &pairs);
+
+        unsigned int objectCount() const;
+        unsigned int cellEntries = 0; //cells covered by all objects in the last findPairs
+    protected:
+        struct Object {
+            unsigned int id;
+            glm::vec2 boundsMin, boundsMax;
+            int cellMinX, cellMinY, cellMaxX, cellMaxY;
+        };
+        struct Entry {
+            int cellX, cellY;
+            unsigned int object; //index into objects
+        };
+
+        std::vector<Object> objects;
+        std::vector<Entry> entries; //grouped by bucket after the counting sort
+        std::vector<unsigned int> bucketStart; //where each bucket begins in entries, plus one past the end
+
+        unsigned int bucketOf(int cellX, int cellY, unsigned int mask) const;
+};
+
+#endif // SPATIALHASH_H
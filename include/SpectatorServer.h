@@ -0,0 +1,107 @@
+#ifndef SPECTATORSERVER_H
+#define SPECTATORSERVER_H
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Simulation.h"
+#include "SpscRing.h"
+
+//streams the match to spectators over TCP or a Unix socket, without rendering anything for them.
+//Each tick is serialized once into a SpectatorFrame, and every client's queue holds a reference
+//to that one buffer, the sends gather straight from it (no per-client copies). A client that
+//can't keep up has its oldest unsent frames dropped once MAX_QUEUED are waiting, so it skips
+//ticks instead of making the server buffer for it, and one that takes nothing at all for
+//stallTimeout seconds is disconnected. Winsock on Windows, where listenUnix() needs a
+//toolchain with afunix.h (and Windows 10 1803 or later to run)
+//
+//stream: frames back to back, each a SpectatorHeader then SpectatorSprites for the paddle,
+//the second paddle (SPECTATE_TWO_PLAYER only), the ball and ballCount extra balls
+
+enum SpectatorFlags {
+    SPECTATE_LOST = 1,
+    SPECTATE_SHAKE = 2, //screen shake, the ball just hit a paddle
+    SPECTATE_INVERT = 4, //colors inverted
+    SPECTATE_TWO_PLAYER = 8
+};
+
+struct SpectatorHeader {
+    unsigned int size; //of the whole frame, header included
+    unsigned int tick;
+    double time; //steady clock seconds it was built at, for measuring latency on the same machine
+    unsigned char flags; //SpectatorFlags
+    unsigned char loser; //Simulation::loser
+    unsigned short reserved;
+    unsigned int ballCount; //extra balls
+};
+
+struct SpectatorSprite {
+    float x, y, rotation;
+    unsigned char color[4]; //RGBA
+};
+
+//shared by every client it's queued for, freed when the last one has sent it
+typedef std::shared_ptr<const std::vector<unsigned char> > SpectatorFrame;
+
+//effects is SPECTATE_SHAKE/SPECTATE_INVERT, the rest comes from the simulation
+SpectatorFrame makeSpectatorFrame(const Simulation &sim, unsigned int effects);
+
+class SpectatorServer
+{
+    public:
+        static const unsigned int MAX_QUEUED = 64; //frames a client can fall behind by
+        static const unsigned int MAX_GATHER = 64; //frames handed to one send
+
+        SpectatorServer();
+        ~SpectatorServer();
+
+        static double now(); //seconds, the clock SpectatorHeader::time is on
+
+        //either or both, then start()
+        bool listenTcp(unsigned short port);
+        bool listenUnix(const std::string &path);
+        bool start(); //the network thread
+        void stop();
+
+        //game side, once per tick: hands the frame to the network thread, never blocks
+        void broadcast(const SpectatorFrame &frame);
+
+        double stallTimeout = 5.0;
+
+        std::atomic<unsigned int> clients{0};
+        std::atomic<unsigned long long> framesSent{0}; //whole frames, summed over clients
+        std::atomic<unsigned long long> framesDropped{0}; //skipped for clients that fell behind
+        std::atomic<unsigned long long> bytesSent{0};
+        std::atomic<unsigned long long> kicked{0}; //disconnected for taking nothing
+    protected:
+        struct Client {
+            long long fd; //a SOCKET on Windows
+            std::deque<SpectatorFrame> queue;
+            size_t offset; //bytes of the front frame already sent
+            double lastProgress; //now() time it last took some bytes, or its queue last started filling
+        };
+        std::vector<Client> list; //network thread only
+        long long listeners[2];
+        bool tcp[2];
+        unsigned int listenerCount = 0;
+        std::string unixPath;
+        //broadcast() writes to it so the network thread's poll() returns. A pipe, or on Windows
+        //a loopback UDP socket connected to itself (both ends are the same socket)
+        long long wake[2];
+        std::atomic<bool> woken{false};
+
+        SpscRing<SpectatorFrame, 256> frames; //broadcast() to the network thread
+        std::thread thread;
+        std::atomic<bool> running{false};
+
+        bool listenOn(long long fd, bool isTcp);
+        void run();
+        void accept(unsigned int listener, double time);
+        void enqueue(Client &client, const SpectatorFrame &frame, double time);
+        bool flush(Client &client, double time); //false if it has to go
+};
+
+#endif // SPECTATORSERVER_H
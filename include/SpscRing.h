@@ -0,0 +1,69 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+
+//fixed-size queue for exactly one producer thread and one consumer thread.
+//No locks and no allocation after construction: push and pop are a copy and
+//one atomic store each. CAPACITY has to be a power of two
+
+template <typename T, unsigned int CAPACITY>
+class SpscRing
+{
+    static_assert(CAPACITY != 0 && (CAPACITY & (CAPACITY - 1)) == 0, "SpscRing capacity must be a power of two");
+    public:
+        //producer only, false (and the item is dropped) when the ring is full
+        bool push(const T &item)
+        {
+            unsigned int t = tail.load(std::memory_order_relaxed);
+            if (t - head.load(std::memory_order_acquire) == CAPACITY)
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            items[t & (CAPACITY - 1)] = item;
+            tail.store(t + 1, std::memory_order_release); //publishes the item
+            return true;
+        }
+
+        //consumer only, the oldest item or NULL if empty. Stays valid until pop()
+        const T *front() const
+        {
+            unsigned int h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire))
+                return NULL;
+            return &items[h & (CAPACITY - 1)];
+        }
+
+        //consumer only
+        bool pop(T &item)
+        {
+            const T *oldest = front();
+            if (!oldest)
+                return false;
+            item = *oldest;
+            pop();
+            return true;
+        }
+        void pop() //drops the front item, call only after front() returned one
+        {
+            head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); //frees the slot
+        }
+
+        unsigned int size() const //either side, may be stale by the time it's used
+        {
+            return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+        }
+        unsigned int capacity() const { return CAPACITY; }
+        unsigned long long droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+    private:
+        //the indices only ever count up (wrapping is fine, CAPACITY divides 2^32) and
+        //live on their own cache lines so the two threads don't fight over one
+        alignas(64) std::atomic<unsigned int> head{0}; //written by the consumer
+        alignas(64) std::atomic<unsigned int> tail{0}; //written by the producer
+        alignas(64) std::atomic<unsigned long long> dropped{0};
+        T items[CAPACITY];
+};
+
+#endif // SPSCRING_H
@@ -0,0 +1,44 @@
+#ifndef TEXTUREATLAS_H
+#define TEXTUREATLAS_H
+
+#include <GL/glew.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Texture.h"
+#include "SkylinePacker.h"
+
+//many images packed into one texture, so sprites with different images share a
+//binding and batch into one draw. Images are named by handle, an index into the UV
+//rect table, so drawing never has to look anything up by name
+
+typedef unsigned int AtlasHandle;
+
+class TextureAtlas
+{
+    public:
+        TextureAtlas(int width = 2048, int height = 2048, int padding = 1);
+
+        Texture2D texture;
+        SkylinePacker packer;
+        int padding; //empty texels kept around every image so filtering doesn't bleed
+        AtlasHandle blank; //a single white texel, for untextured sprites
+
+        AtlasHandle reserve(); //a handle that shows blank until an image is placed for it
+        AtlasHandle add(int width, int height, const unsigned char *rgba); //place and upload right now
+
+        //finds room for the image, the caller uploads the pixels to x, y and then activates it
+        bool place(AtlasHandle handle, int width, int height, int &x, int &y);
+        void activate(AtlasHandle handle); //the handle's UV rect now points at its own pixels
+
+        const glm::vec4 &uv(AtlasHandle handle) const //x, y, width, height, for SpriteRenderer
+        {
+            return uvRects[handle];
+        }
+    protected:
+        std::vector<glm::vec4> uvRects; //what sprites use, indexed by handle
+        std::vector<glm::vec4> placed; //where the image really is, once it has been placed
+
+        glm::vec4 rectFor(int x, int y, int width, int height) const;
+};
+
+#endif // TEXTUREATLAS_H
@@ -0,0 +1,65 @@
+#ifndef TEXTURELOADER_H
+#define TEXTURELOADER_H
+
+#include <GL/glew.h>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Texture.h"
+#include "TextureAtlas.h"
+
+//loads textures without stalling startup: images are decoded on worker threads and
+//streamed into GL through pixel buffer objects a few at a time, whatever they were
+//requested for shows a placeholder until the upload has landed
+
+class TextureLoader
+{
+    public:
+        TextureLoader(unsigned int threads = 2);
+        ~TextureLoader();
+
+        //slot is set to placeholder now and to the loaded texture once it's ready.
+        //The future turns true when it's ready, false if the image couldn't be read
+        std::shared_future<bool> load(const std::string &path, Texture2D &slot, const Texture2D &placeholder);
+        //same, but packed into an atlas: handle (from atlas.reserve()) shows the atlas' blank until then
+        std::shared_future<bool> load(const std::string &path, TextureAtlas &atlas, AtlasHandle handle);
+
+        //GL thread, once a frame: starts uploads for decoded images and finishes the ones the GPU is done with
+        void poll();
+
+        unsigned int pending(); //requests that haven't finished yet
+        GLsizeiptr uploadBudget = 8*1024*1024; //bytes of pixels copied into PBOs per poll
+    protected:
+        struct Job {
+            std::string path;
+            Texture2D *slot = nullptr; //one of these two is the destination
+            TextureAtlas *atlas = nullptr;
+            AtlasHandle handle = 0;
+            std::promise<bool> done;
+            unsigned char *pixels = nullptr; //set by the decoding worker
+            int width = 0, height = 0;
+            GLuint pbo = 0;
+            GLsync fence = 0;
+            std::unique_ptr<Texture2D> texture; //the new texture, when loading into a slot
+        };
+
+        std::vector<std::thread> workers;
+        std::mutex lock;
+        std::condition_variable wake;
+        bool stopping = false;
+        std::deque<std::shared_ptr<Job> > toDecode; //guarded by lock
+        std::deque<std::shared_ptr<Job> > decoded; //guarded by lock
+        std::vector<std::shared_ptr<Job> > uploading; //GL thread only
+        unsigned int requested = 0, finished = 0;
+
+        std::shared_future<bool> queue(std::shared_ptr<Job> job);
+        void decodeLoop();
+        bool startUpload(Job &job);
+};
+
+#endif // TEXTURELOADER_H
@@ -0,0 +1,45 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+//hands the latest copy of a T from one writer thread to one reader thread without
+//locks or waiting. The writer fills back() and publishes it, the reader takes the
+//newest published copy whenever it likes; each side owns one slot and the third is
+//passed between them with a single atomic exchange. Copies the reader never got
+//to are simply overwritten
+
+template <typename T>
+class TripleBuffer
+{
+    public:
+        //writer only: the slot to fill, keeps its old contents (and allocations)
+        T &back() { return slots[backIndex]; }
+        void publish()
+        {
+            unsigned int previous = shared.exchange(backIndex | FRESH, std::memory_order_acq_rel);
+            backIndex = previous & INDEX;
+        }
+
+        //reader only: the newest published copy, stays put until the next read()
+        const T &read()
+        {
+            if (shared.load(std::memory_order_relaxed) & FRESH)
+            {
+                unsigned int previous = shared.exchange(frontIndex, std::memory_order_acq_rel);
+                frontIndex = previous & INDEX;
+            }
+            return slots[frontIndex];
+        }
+        bool fresh() const { return (shared.load(std::memory_order_relaxed) & FRESH) != 0; } //something new to read
+    private:
+        static const unsigned int INDEX = 3;
+        static const unsigned int FRESH = 4; //set when the shared slot holds a copy the reader hasn't seen
+
+        T slots[3];
+        unsigned int backIndex = 0; //writer's
+        unsigned int frontIndex = 1; //reader's
+        std::atomic<unsigned int> shared{2};
+};
+
+#endif // TRIPLEBUFFER_H
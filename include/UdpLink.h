@@ -0,0 +1,56 @@
+#ifndef UDPLINK_H
+#define UDPLINK_H
+
+#include <string>
+#include <vector>
+
+//a non-blocking UDP socket talking to one peer.
+//What this side sends can go through a shim that holds packets back and drops
+//some of them, so networked play can be tried over localhost as if it were a
+//real connection (run both sides with it to get it both ways)
+
+class UdpLink
+{
+    public:
+        static const unsigned int MAX_PACKET = 60000; //under the 65507 a UDP datagram can carry
+
+        UdpLink();
+        ~UdpLink();
+
+        bool listen(unsigned short port); //the peer is whoever sends the first packet
+        bool connect(const std::string &address, unsigned short port); //numeric address or host name
+        void close();
+        bool isOpen() const { return handle != -1; }
+        bool hasPeer() const { return peerPort != 0; }
+
+        bool send(const void *data, unsigned int size); //to the peer, through the shim
+        int receive(void *data, unsigned int size); //one packet from the peer, -1 if none is waiting
+        void pump(); //sends what the shim has held back long enough, call often
+
+        //the shim
+        float latency = 0.0; //ms added to every packet
+        float jitter = 0.0; //ms, up to this much more at random (so packets can arrive out of order)
+        float loss = 0.0; //0 to 1, fraction of packets dropped
+
+        unsigned long long sent = 0, dropped = 0, received = 0; //packets
+        unsigned long long bytesSent = 0;
+
+        static double now(); //seconds, steady clock
+    protected:
+        long long handle = -1; //the socket (a SOCKET on Windows)
+        unsigned int peerAddress = 0; //IPv4, network byte order
+        unsigned short peerPort = 0; //network byte order, 0 until there's a peer
+
+        struct Delayed {
+            double due; //now() time it goes out
+            std::vector<unsigned char> data;
+        };
+        std::vector<Delayed> delayed; //held back by the shim, in no particular order
+        unsigned int rngState = 0x2545F491;
+
+        bool open(unsigned short port); //port 0 for any
+        bool sendNow(const void *data, unsigned int size);
+        float random(); //0 to 1
+};
+
+#endif // UDPLINK_H
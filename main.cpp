@@ -6,30 +6,56 @@
 #include <SFML/Window.hpp>
 #include <cstdlib>
 #include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
 #include <vector>
 #include <map>
+#include <atomic>
+#include <thread>
+#include <chrono>
 #include "Shader.cpp"
 #include "Sprite.h"
+#include "SpriteRenderer.h"
 #include "Texture.h"
+#include "TextureAtlas.h"
+#include "TextureLoader.h"
+#include "AssetPack.h"
 #include "Framebuffer.h"
 #include "ParticleSystem.h"
+#include "GPUParticleSystem.h"
+#include "FrameUniforms.h"
+#include "FixedTimestep.h"
+#include "Simulation.h"
+#include "Profiler.h"
+#include "GLState.h"
+#include "InputPoller.h"
+#include "TripleBuffer.h"
+#include "ResolutionScaler.h"
+#include "GPUFrameTimer.h"
+#include "Replay.h"
+#include "RollbackSession.h"
+#include "SpectatorServer.h"
 #define GLSL(src) "#version 330 core\n" #src
+//same as GLSL, but also declares the per-frame uniform block (see FrameUniforms.h)
+#define GLSL_FRAME(src) "#version 330 core\n" \
+    "layout(std140) uniform Frame { mat4 proj; float time; };\n" #src
 
 using namespace std;
 using namespace sf;
 using namespace glm;
 
-const GLchar* vertexSource = GLSL(
+const GLchar* vertexSource = GLSL_FRAME(
     layout(location=0) in vec2 pos;
     layout(location=1) in vec2 texc;
 
     out vec2 texcoord;
 
     uniform mat4 model;
-    uniform mat4 proj;
+    uniform vec4 uvRect; //part of the texture to use, for atlases
     void main()
     {
-        texcoord = texc;
+        texcoord = uvRect.xy + texc*uvRect.zw;
         gl_Position = proj * model * vec4(pos, 0.0, 1.0);
     }
 );
@@ -48,55 +74,110 @@ const GLchar* fragmentSource = GLSL(
     }
 );
 
-const GLchar* frameVSource = GLSL(
+const GLchar* batchVSource = GLSL_FRAME(
+    layout(location=0) in vec2 pos;
+    layout(location=1) in vec2 texc;
+    layout(location=2) in mat4 model; //per-instance, takes locations 2-5
+    layout(location=6) in vec4 uvRect;
+    layout(location=7) in vec3 color;
+
+    out vec2 texcoord;
+    out vec3 tint;
+
+    void main()
+    {
+        texcoord = uvRect.xy + texc*uvRect.zw;
+        tint = color;
+        gl_Position = proj * model * vec4(pos, 0.0, 1.0);
+    }
+);
+
+const GLchar* batchFSource = GLSL(
+    in vec2 texcoord;
+    in vec3 tint;
+
+    out vec4 outColor;
+
+    uniform sampler2D tex;
+    void main()
+    {
+        outColor = texture(tex, texcoord) * vec4(tint, 1.0);
+    }
+);
+
+//post-processing passes (see Framebuffer), each one a full-screen quad reading the previous image
+const GLchar* postVSource = GLSL(
     layout (location = 0) in vec2 pos;
     layout (location = 1) in vec2 texc;
 
     out vec2 texcoord;
 
-    uniform bool shake;
-    uniform float time;
     void main()
     {
         texcoord = texc;
         gl_Position = vec4(pos, 0.0, 1.0);
+    }
+);
 
-        if (shake)
-        {
-            float strength = 0.01;
-            gl_Position.x += strength * cos(10*time);
-            gl_Position.y += strength * cos(15*time);
-        }
+const GLchar* shakeVSource = GLSL_FRAME(
+    layout (location = 0) in vec2 pos;
+    layout (location = 1) in vec2 texc;
+
+    out vec2 texcoord;
+
+    void main()
+    {
+        texcoord = texc;
+        gl_Position = vec4(pos, 0.0, 1.0);
+
+        float strength = 0.01;
+        gl_Position.x += strength * cos(10*time);
+        gl_Position.y += strength * cos(15*time);
     }
 );
 
-const GLchar* frameFSource = GLSL(
+const GLchar* copyFSource = GLSL(
     in vec2 texcoord;
 
     out vec4 outColor;
 
     uniform sampler2D scene;
-    uniform bool invert = false;
-    uniform bool gray = false;
     void main()
     {
-        if (invert) {
-            outColor = vec4(1.0 - vec3(texture(scene, texcoord)), 1.0);
-        } else if (gray) {
-            vec4 origColor = texture(scene, texcoord);
-            float average = 0.2126 * origColor.r + 0.7152 * origColor.g + 0.0722 * origColor.b;
-            outColor = vec4(average, average, average, 1.0);
-        } else {
-            outColor = vec4(vec3(texture(scene, texcoord)), 1.0);
-        }
+        outColor = vec4(vec3(texture(scene, texcoord)), 1.0);
+    }
+);
+
+const GLchar* invertFSource = GLSL(
+    in vec2 texcoord;
+
+    out vec4 outColor;
+
+    uniform sampler2D scene;
+    void main()
+    {
+        outColor = vec4(1.0 - vec3(texture(scene, texcoord)), 1.0);
+    }
+);
+
+const GLchar* grayFSource = GLSL(
+    in vec2 texcoord;
+
+    out vec4 outColor;
+
+    uniform sampler2D scene;
+    void main()
+    {
+        vec4 origColor = texture(scene, texcoord);
+        float average = 0.2126 * origColor.r + 0.7152 * origColor.g + 0.0722 * origColor.b;
+        outColor = vec4(average, average, average, 1.0);
     }
 );
 
-const GLchar* particleVSource = GLSL(
+const GLchar* particleVSource = GLSL_FRAME(
     layout(location=0) in vec2 position;
 
 
-    uniform mat4 proj;
     uniform mat4 model;
     void main()
     {
@@ -121,6 +202,8 @@ const GLchar* particleGSource = GLSL(
         EmitVertex();
 
         gl_Position = gl_in[0].gl_Position + vec4(-squareSize, -squareSize, 0.0, 0.0);
+        EmitVertex();
+        EndPrimitive();
     }
 );
 
@@ -136,6 +219,81 @@ const GLchar* particleFSource = GLSL(
     }
 );
 
+//GPU particles: the update runs in this vertex shader and its outputs are
+//captured with transform feedback into the other buffer
+const GLchar* gpuParticleUpdateSource = GLSL(
+    layout(location=0) in vec2 position;
+    layout(location=1) in vec2 velocity;
+    layout(location=2) in float life;
+
+    out vec2 outPosition;
+    out vec2 outVelocity;
+    out float outLife;
+
+    uniform vec2 emitter;
+    uniform vec2 ballVel;
+    uniform float dt;
+    uniform float lifetime;
+    void main()
+    {
+        float left = life - dt;
+        bool dead = (left <= 0.0);
+        outLife = dead ? lifetime : left;
+        outVelocity = dead ? -ballVel : velocity;
+        outPosition = (dead ? emitter : position) - ballVel*dt;
+    }
+);
+
+const GLchar* gpuParticleVSource = GLSL(
+    layout(location=0) in vec2 position;
+    layout(location=2) in float life;
+
+    out float fade;
+
+    uniform float lifetime;
+    void main()
+    {
+        fade = life/lifetime;
+        gl_Position = vec4(position, 0.0, 1.0); //still in pixels, the geometry shader projects
+    }
+);
+
+const GLchar* gpuParticleGSource = GLSL_FRAME(
+    layout (points) in;
+    layout (triangle_strip, max_vertices = 4) out;
+
+    in float fade[];
+    out float alpha;
+
+    uniform float size;
+    void main()
+    {
+        vec2 center = gl_in[0].gl_Position.xy;
+        alpha = fade[0];
+        gl_Position = proj * vec4(center + vec2(-size, -size), 0.0, 1.0);
+        EmitVertex();
+        gl_Position = proj * vec4(center + vec2(size, -size), 0.0, 1.0);
+        EmitVertex();
+        gl_Position = proj * vec4(center + vec2(-size, size), 0.0, 1.0);
+        EmitVertex();
+        gl_Position = proj * vec4(center + vec2(size, size), 0.0, 1.0);
+        EmitVertex();
+        EndPrimitive();
+    }
+);
+
+const GLchar* gpuParticleFSource = GLSL(
+    in float alpha;
+
+    out vec4 outColor;
+
+    uniform vec3 color;
+    void main()
+    {
+        outColor = vec4(color, alpha);
+    }
+);
+
 void initGL()
 {
     glewExperimental = GL_TRUE;
@@ -151,22 +309,25 @@ enum GameState {
     GAME_WIN,
 };
 
-int randUInt(int rmin, int rmax)
-{
-    int mod = rmax - rmin + 1;
-    int randint = (rand()%mod) + rmin;
-    return randint;
-}
-
-/*int randInt(int rmin, int rmax) //TO BE IMPLEMENTED
-{
-    if (rmin < 0)
-    {
-        int rand_sign = (rand()%2) ? -1 : 1;
-    } else {
-        return randUInt(rmin, rmax);
-    }
-}*/
+//everything render() needs, copied out of the simulation after its ticks so the
+//render thread never touches live game state
+struct Snapshot {
+    Snapshot() : ball(vec2(0.0, 0.0)), paddle(vec2(0.0, 0.0)), paddle2(vec2(0.0, 0.0)) {}
+
+    GameState state = GAME_MENU;
+    Sprite ball, paddle, paddle2;
+    bool twoPlayer = false;
+    vector<Sprite> balls; //multi-ball
+    vec2 ballVel;
+    bool lost = false;
+    bool shake = false, invert = false, batchSprites = true, showTrail = false;
+    double time = 0.0; //game time
+    unsigned long long ticks = 0; //ticks simulated so far
+    double tickTime = 0.0; //InputPoller::now() time the last tick ended at
+    float dt = 0.0; //tick length, sprites are drawn blended over the tick after tickTime
+    unsigned int rollbackDepth = 0; //networked play, deepest rollback in the ticks since the last snapshot
+    double resimMs = 0.0; //and how long re-simulating took
+};
 
 class Game
 {
@@ -178,44 +339,70 @@ class Game
 
         SpriteRenderer *renderer;
 
-        Texture2D BLANK;
-        map <string, Texture2D> textures;
+        TextureAtlas *atlas; //every sprite image, packed into one texture
+        AtlasHandle faceImage, catImage;
+        TextureLoader *loader; //decodes images in the background and uploads them into the atlas
+        AssetPack pack; //baked assets, used instead of the loose files when present
+        string packPath = "pong.pak";
 
         Framebuffer *fb;
+        FrameUniforms *frame; //projection, time and effect flags for every shader
+        GPUFrameTimer gpuTime; //scene and post passes, what the render scale can make cheaper
 
         float shakeTime = 0.0;
-        bool invert;
+        bool invert = false;
+        bool batchSprites = true; //draw with SpriteRenderer's batched path
 
         Sprite *playButton;
         Sprite *quitButton;
 
-        Sprite *player1;
-        Sprite *ball;
-        vec2 ballVel;
+        Simulation sim; //paddle, ball and the rules of the match
+        unsigned int extraBalls = 0; //multi-ball mode, set with --balls
+        unsigned int seed = 0;
+        ReplayWriter *recorder = nullptr; //--record, gets every tick's input
+        ReplayReader *replay = nullptr; //--replay, input comes from here instead of the keys
+        bool toggleColor = false; //clicked the paddle, goes to the sim with the next tick
+        RollbackSession *net = nullptr; //two players over UDP, set up by --host or --join
+        SpectatorServer *spectators = nullptr; //gets every tick, --spectate-port/--spectate-socket
         Sprite *cursorSpr;
 
         //ParticleSystem *ps;
+        GPUParticleSystem *trail; //ball trail, simulated on the GPU
+        bool showTrail = false;
+        double trailTime = 0.0; //game time the trail was last advanced to
 
         vec2 mousePos;
 
-        vector<Event> events;
+        EventRing events; //window events, pushed by the main loop in the order they arrived
+        InputPoller poller; //paddle keys, sampled on their own thread
+        double inputTime = 0.0; //InputPoller::now() time the last tick ended at
+        bool upPressed = false, downPressed = false; //paddle keys as of inputTime
 
-        double totalTime;
+        double totalTime = 0.0;
+        unsigned long long ticks = 0;
+        float tickLength = 0.0; //dt of the last update
         //Clock speedClock;
 
-        bool lost = false;
+        //update() runs on the simulation thread and render() on the GL thread,
+        //they only share what goes through here
+        TripleBuffer<Snapshot> snapshots;
+        unsigned long long renderedTicks = 0; //render thread, for the ticks counter
 
         // Constructor/Destructor
         Game(int w, int h);
         ~Game();
         // Initialize game state (load all shaders/textures/levels)
         void init();
+        AtlasHandle loadImage(const char *name); //from the pack if it's there, else the loose file
         // GameLoop
         void update(float dt);
+        void publish(); //after a batch of updates, makes the new state visible to render()
         void render();
+    protected:
+        SimInput paddleInput(double tickEnd, float dt); //replays the poller's events up to tickEnd
 };
 
-Game::Game(int w, int h)
+Game::Game(int w, int h) : sim(w, h)
 {
     width = w;
     height = h;
@@ -224,93 +411,113 @@ Game::Game(int w, int h)
 void Game::init()
 {
     //initialize textures and such here...
-    srand(time(NULL)); //seed
+    sim.reset(seed);
+    sim.addBalls(extraBalls);
+    if (net)
+        net->start(sim); //the match both sides agreed on, with the second paddle
 
     mat4 proj = ortho(0.0f, static_cast<float>(width), static_cast<float>(height), 0.0f, -1.0f,  1.0f); //projection
 
+    frame = new FrameUniforms();
+    frame->data.proj = proj;
+
+    atlas = new TextureAtlas(); //images show the atlas' blank texel until they've loaded
+    loader = new TextureLoader(); //decoding starts now and overlaps the shader builds
+    pack.open(packPath);
+    faceImage = loadImage("textures/awesomeface.png");
+    catImage = loadImage("textures/cat.jpg");
+
+    //every program is started before any of them is used, so drivers with
+    //parallel compiles build them all at once
     Shader spriteShader; //shader for sprites
     spriteShader.Compile(vertexSource, fragmentSource);
 
-    Shader frameShader; //frame buffer shader
-    frameShader.Compile(frameVSource, frameFSource);
+    Shader batchShader; //instanced shader for batched sprites
+    batchShader.Compile(batchVSource, batchFSource);
+
+    Shader grayShader; //post-processing passes
+    grayShader.Compile(postVSource, grayFSource);
+    Shader invertShader;
+    invertShader.Compile(postVSource, invertFSource);
+    Shader shakeShader;
+    shakeShader.Compile(shakeVSource, copyFSource);
 
     Shader particleShader;
     particleShader.Compile(particleVSource, particleFSource, particleGSource);
 
-    fb = new Framebuffer(frameShader, width, height);
+    Shader trailUpdateShader;
+    trailUpdateShader.CompileFeedback(gpuParticleUpdateSource, GPUParticleSystem::VARYINGS, GPUParticleSystem::VARYING_COUNT);
+    Shader trailShader;
+    trailShader.Compile(gpuParticleVSource, gpuParticleFSource, gpuParticleGSource);
 
-    playButton = new Sprite(vec2(130, 45), vec2(335, 250)); //button for playing
+    fb = new Framebuffer(width, height);
+    fb->AddPass("gray", grayShader, false); //turned on and off every frame to match the game
+    fb->AddPass("invert", invertShader, false);
+    fb->AddPass("shake", shakeShader, false);
 
+    playButton = new Sprite(vec2(130, 45), vec2(335, 250)); //button for playing
 
-    player1 = new Sprite(vec2(45, 130), vec2(30, 20));
-    player1->color = vec3(0.0f, 1.0f, 0.0f); //player 1
 
-    ball = new Sprite(vec2(70, 70), vec2(randUInt(70, 700), randUInt(70, 500)));
-    //ball->color = vec3(255, 0, 216);
-    float magnitude = randUInt(600, 900);
-    int ang = randUInt(25, 70);
-    ballVel = vec2(magnitude * cos(ang), magnitude*sin(ang));
+    //ps = new ParticleSystem(sim.ball.position, particleShader, 10, 3, sim.ballVel);
 
-    //ps = new ParticleSystem(ball->position, particleShader, 10, proj, 3, ballVel);
+    trail = new GPUParticleSystem(trailUpdateShader, trailShader, 4000, 0.5);
 
     cursorSpr = new Sprite(vec2(30, 30));
 
-    Texture2D Face;
-    int w, h;
-    unsigned char* image =
-    SOIL_load_image("textures\\awesomeface.png", &w, &h, 0, SOIL_LOAD_RGBA);
-    Face.Generate(w, h, image);
-    SOIL_free_image_data(image);
-    textures["face"] = Face;
-
-    Texture2D Cat;
-    image = SOIL_load_image("textures\\cat.jpg", &w, &h, 0, SOIL_LOAD_RGBA);
-    Cat.Generate(w, h, image);
-    SOIL_free_image_data(image);
-    textures["cat"] = Cat;
-
-    BLANK.GenerateBlank(); //blank texture
-
-    renderer = new SpriteRenderer(spriteShader, proj); //renderer
+    renderer = new SpriteRenderer(spriteShader, batchShader); //renderer
 
 
     state = GAME_ACTIVE;
-    fb->BindTextureBuffer();
+    publish();
+}
+
+AtlasHandle Game::loadImage(const char *name)
+{
+    const PackEntry *entry = pack.find(name);
+    if (entry && entry->type == ASSET_TEXTURE && entry->format == GL_RGBA)
+    {
+        //already decoded, the pixels go to GL straight from the mapped file
+        return atlas->add(entry->width, entry->height, pack.data(*entry));
+    }
+    AtlasHandle handle = atlas->reserve();
+    loader->load(name, *atlas, handle);
+    return handle;
 }
 
 void Game::update(float dt)
 {
     totalTime += dt;
-    fb->shader.SetFloat("time", totalTime);
+    ticks++;
+    tickLength = dt;
     switch (state)
     {
         case GAME_ACTIVE:
         {
-            while (events.size() != 0)
+            TimedEvent timedEv;
+            while (events.pop(timedEv)) //oldest first
             {
-                Event ev = events[events.size() - 1];
-                events.pop_back();
+                Event &ev = timedEv.event;
                 switch (ev.type)
                 {
+                    case Event::MouseMoved:
+                        mousePos = vec2(ev.mouseMove.x, ev.mouseMove.y);
+                        break;
                     case Event::MouseButtonPressed:
-                        if (player1->contains(mousePos) && (!lost))
+                        mousePos = vec2(ev.mouseButton.x, ev.mouseButton.y);
+                        if (((net && net->player == 1) ? sim.paddle2 : sim.paddle).contains(mousePos))
                         {
-                            player1->color = (player1->color == vec3(0.0, 1.0, 0.0)) ?
-                            vec3(1.0, 0.6666, 0.98) : vec3(0.0, 1.0, 0.0);
+                            toggleColor = true; //part of the input, so recordings have it
                         }
 
                         break;
                     case Event::KeyReleased:
                         if (ev.key.code == Keyboard::I)
                         {
-                            if (invert)
-                            {
-                                invert = false;
-                                fb->shader.SetBool("invert", false);
-                            } else {
-                                invert = true;
-                                fb->shader.SetBool("invert", true);
-                            }
+                            invert = !invert;
+                        } else if (ev.key.code == Keyboard::B) {
+                            batchSprites = !batchSprites; //compare against the per-sprite path
+                        } else if (ev.key.code == Keyboard::T) {
+                            showTrail = !showTrail;
                         }
                         break;
                 }
@@ -319,66 +526,46 @@ void Game::update(float dt)
             if (shakeTime > 0.0)
             {
                 shakeTime -= dt;
-            } else {
-                fb->shader.SetBool("shake", false);
             }
 
-            if (Keyboard::isKeyPressed(Keyboard::Up)) //handle input
+            SimInput input = quantizeInput(paddleInput(inputTime + dt, dt)); //handle input
+            input.togglePaddleColor = toggleColor;
+            toggleColor = false;
+            if (replay)
             {
-                if ((player1->position.y >= 0.0f) && (!lost))
+                SimInput recorded;
+                if (replay->next(recorded))
                 {
-                    player1->position.y -= 450.0f*dt;
+                    input = recorded;
+                } else {
+                    cout << "Replay finished after " << sim.tick << " ticks, "
+                        << replay->checksumsChecked << " checksums checked" << endl;
+                    delete replay;
+                    replay = nullptr;
                 }
             }
-            if (Keyboard::isKeyPressed(Keyboard::Down))
+
+            SimEvents result;
+            bool stepped = true;
+            if (net)
+                stepped = net->advance(input, result); //doesn't step at all while waiting on the other player
+            else
+                result = sim.step(input, dt);
+            if (replay && !replay->verify(sim) && replay->mismatchTick == sim.tick)
             {
-                if ((player1->position.y + player1->size.y <= 600.0f) && (!lost))
-                {
-                    player1->position.y += 450.0f*dt;
-                }
+                cout << "Replay diverged at tick " << sim.tick << endl;
             }
-
-            //do collisions
-            vec2 ballCenter = ball->position + (0.5f*ball->size);
-            float radius = 0.5f*ball->size.x;
-            if (!lost)
+            if (recorder)
             {
-                if (ballCenter.x + radius >= width) //keep the ball inside the court
-                {
-                    ballVel.x *= -1.0f;
-                    ball->move(-0.5, 0.0);
-                } else if (ballCenter.x - radius <= 0) {
-                    ballVel.x *= -1.0f;
-                    ball->move(0.5, 0.0);
-                    lost = true;
-                    fb->shader.SetBool("gray", true);
-                }
-                if (ballCenter.y - radius <= 0)
-                {
-                    ballVel.y *= -1.0f;
-                    ball->move(0, 0.5);
-                } else if (ballCenter.y + radius >= height) {
-                    ballVel.y *= -1.0f;
-                    ball->move(0, -0.5);
-                }
+                recorder->record(input, sim);
             }
-
-            if (checkCollision(*player1, *ball) && !(lost)) //handle collisions
+            if (result.paddleHit)
             {
                 shakeTime = 0.07;
-                fb->shader.SetBool("shake", true);
-                if (ballCenter.x <= player1->position.x + player1->size.x)
-                {
-                    ballVel.y *= -1.0f;
-                } else {
-                    ballVel.x *= -1.0f;
-                }
             }
-
-            if (!lost)
+            if (spectators && stepped)
             {
-                ball->move(ballVel*dt);
-                ball->rotate(dt); //spin ball
+                spectators->broadcast(makeSpectatorFrame(sim, ((shakeTime > 0.0) ? SPECTATE_SHAKE : 0) | (invert ? SPECTATE_INVERT : 0)));
             }
 
             cursorSpr->position = mousePos - (0.5f*cursorSpr->size);
@@ -386,93 +573,486 @@ void Game::update(float dt)
         }
         case GAME_MENU:
         {
-            while (events.size() != 0)
+            TimedEvent ev;
+            while (events.pop(ev))
             {
-                Event ev = events[events.size() - 1];
-                events.pop_back();
-                switch (ev.type)
+                switch (ev.event.type)
                 {
 
                 }
             }
+            paddleInput(inputTime + dt, dt); //keep the key state current
             break;
         }
     }
+    inputTime += dt;
+}
+
+SimInput Game::paddleInput(double tickEnd, float dt)
+{
+    //walk the key changes that happened during this tick, adding up how long each key was down
+    double tickStart = tickEnd - dt;
+    double cursor = tickStart;
+    double upTime = 0.0, downTime = 0.0;
+    SimInput input;
+    input.up = upPressed;
+    input.down = downPressed;
+    const TimedEvent *next;
+    while ((next = poller.events.front()) && next->time <= tickEnd)
+    {
+        double t = std::max(next->time, tickStart); //anything older than the tick counts from its start
+        if (upPressed)
+            upTime += t - cursor;
+        if (downPressed)
+            downTime += t - cursor;
+        cursor = t;
+
+        bool pressed = (next->event.type == Event::KeyPressed);
+        if (next->event.key.code == poller.keys[0])
+        {
+            upPressed = pressed;
+            input.up = input.up || pressed; //a tap inside one tick still moves the paddle a little
+        } else {
+            downPressed = pressed;
+            input.down = input.down || pressed;
+        }
+        poller.events.pop();
+    }
+    if (upPressed)
+        upTime += tickEnd - cursor;
+    if (downPressed)
+        downTime += tickEnd - cursor;
+    input.upHeld = upTime/dt;
+    input.downHeld = downTime/dt;
+    return input;
+}
+
+void Game::publish()
+{
+    Snapshot &s = snapshots.back();
+    s.state = state;
+    s.ball = sim.ball;
+    s.paddle = sim.paddle;
+    s.paddle2 = sim.paddle2;
+    s.twoPlayer = sim.twoPlayer;
+    s.balls = sim.balls; //reuses the slot's storage once it's big enough
+    s.ballVel = sim.ballVel;
+    s.lost = sim.lost;
+    s.shake = (shakeTime > 0.0);
+    s.invert = invert;
+    s.batchSprites = batchSprites;
+    s.showTrail = showTrail;
+    s.time = totalTime;
+    s.ticks = ticks;
+    s.tickTime = inputTime;
+    s.dt = tickLength;
+    if (net)
+    {
+        s.rollbackDepth = net->frameDepth;
+        s.resimMs = net->frameResimMs;
+        net->endFrame();
+    }
+    snapshots.publish();
 }
 
 void Game::render()
 {
+    const Snapshot &s = snapshots.read(); //only this from here on, the simulation may be mid-tick
+    PROFILE_COUNT("ticks", s.ticks - renderedTicks);
+    renderedTicks = s.ticks;
+    if (s.twoPlayer)
+    {
+        PROFILE_COUNT("rollback depth", s.rollbackDepth);
+        PROFILE_COUNT("re-sim us", (long long)(s.resimMs*1000.0));
+    }
+
+    loader->poll(); //swap in any textures that finished loading
+    frame->data.time = s.time; //one upload per frame for every program
+    frame->upload();
+    fb->EnablePass("gray", s.lost);
+    fb->EnablePass("invert", s.invert);
+    fb->EnablePass("shake", s.shake);
+
+    gpuTime.begin();
+    PROFILE_GPU_BEGIN("scene");
     fb->BeginRender();
 
-    glClearColor(0.0, 0.0, 0.0, 1.0);
+    GLState::get().clearColor(0.0, 0.0, 0.0, 1.0);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    switch (state)
+    //draw one tick behind the simulation, blending between the last two ticks by how far
+    //we are into the current one, so motion is smooth at any refresh rate and tick rate
+    float alpha = 1.0;
+    if (s.dt > 0.0)
+        alpha = glm::clamp((float)((InputPoller::now() - s.tickTime)/s.dt), 0.0f, 1.0f);
+    Sprite ball = s.ball.interpolated(alpha);
+    Sprite paddle = s.paddle.interpolated(alpha);
+    Sprite paddle2 = s.paddle2.interpolated(alpha);
+
+    switch (s.state)
     {
         case GAME_ACTIVE:
-            renderer->drawSprite(textures["face"], *ball);
-            renderer->drawSprite(BLANK, *player1);
+            if (s.batchSprites)
+            {
+                renderer->begin();
+                renderer->submit(atlas->texture, ball, atlas->uv(faceImage));
+                renderer->submit(atlas->texture, paddle, atlas->uv(atlas->blank));
+                if (s.twoPlayer)
+                    renderer->submit(atlas->texture, paddle2, atlas->uv(atlas->blank));
+                for (unsigned int i=0;i<s.balls.size();i++)
+                    renderer->submit(atlas->texture, s.balls[i].interpolated(alpha), atlas->uv(faceImage));
+                renderer->flush();
+                PROFILE_COUNT("sprite draw calls", renderer->drawCalls);
+            } else {
+                renderer->drawSprite(atlas->texture, ball, atlas->uv(faceImage));
+                renderer->drawSprite(atlas->texture, paddle, atlas->uv(atlas->blank));
+                if (s.twoPlayer)
+                    renderer->drawSprite(atlas->texture, paddle2, atlas->uv(atlas->blank));
+                for (unsigned int i=0;i<s.balls.size();i++)
+                    renderer->drawSprite(atlas->texture, s.balls[i].interpolated(alpha), atlas->uv(faceImage));
+                PROFILE_COUNT("sprite draw calls", (s.twoPlayer ? 3 : 2) + s.balls.size());
+            }
+            if (s.showTrail)
+            {
+                trail->position = ball.position + vec2(0.5f*ball.size.x, 0.5f*ball.size.y);
+                trail->update(s.time - trailTime, s.lost ? vec2(0.0, 0.0) : s.ballVel);
+                trail->render();
+            }
+            trailTime = s.time;
             break;
     }
     fb->EndRender();
-    fb->Render(true);
+    PROFILE_GPU_END();
+    fb->Render(); //times each pass under its own name
+    gpuTime.end();
+    PROFILE_COUNT("post passes", fb->ActivePasses());
+
+#ifdef PONG_PROFILE
+    if (Profiler::get().overlay) //frame time graph, one bar per frame, the line is 60 fps
+    {
+        Profiler &profiler = Profiler::get();
+        const float pixelsPerMs = 6.0;
+        renderer->begin();
+        for (unsigned int i=0;i<120;i++)
+        {
+            float ms = profiler.frameTime(i);
+            Sprite bar(vec2(3.0, ms*pixelsPerMs), vec2(10.0 + (119 - i)*4.0, height - 10.0 - ms*pixelsPerMs));
+            bar.color = (ms <= 16.7f) ? vec3(0.0, 0.8, 0.2) : vec3(0.9, 0.1, 0.1);
+            renderer->submit(atlas->texture, bar, atlas->uv(atlas->blank));
+        }
+        Sprite budget(vec2(480.0, 1.0), vec2(10.0, height - 10.0 - 16.7f*pixelsPerMs));
+        budget.color = vec3(1.0, 1.0, 0.0);
+        renderer->submit(atlas->texture, budget, atlas->uv(atlas->blank));
+        renderer->flush();
+    }
+#endif
 }
 
 Game::~Game()
 {
     delete renderer;
-    delete player1;
-    delete ball;
+    delete loader;
+    delete atlas;
+    delete frame;
+    delete trail;
     delete cursorSpr;
 }
 
-int main()
+TimedEvent timed(const Event &ev)
+{
+    TimedEvent timedEv;
+    timedEv.time = InputPoller::now();
+    timedEv.event = ev;
+    return timedEv;
+}
+
+//the simulation thread: runs the ticks as they come due and publishes a snapshot after
+//each batch, so a slow frame or a blocking display() never holds up the physics
+void simulate(Game &game, FixedTimestep &timestep, atomic<bool> &running)
+{
+    double last = InputPoller::now();
+    while (running)
+    {
+        double now = InputPoller::now();
+        unsigned int ticks = timestep.advance(now - last);
+        last = now;
+        //the ticks cover the time up to now, minus what's left in the accumulator
+        game.inputTime = now - timestep.accumulator - ticks*timestep.dt;
+        if (ticks > 0)
+        {
+            PROFILE_SCOPE("update");
+            for (unsigned int i=0;i<ticks;i++)
+            {
+                game.update(timestep.dt);
+            }
+            game.publish();
+        }
+        //sleep until the next tick is due
+        this_thread::sleep_for(chrono::duration<double>(timestep.dt - timestep.accumulator));
+    }
+}
+
+int main(int argc, char* argv[])
 {
+    float tickRate = 120.0; //simulation ticks per second
+    unsigned int balls = 0;
+    string packPath = "pong.pak";
+    ResolutionScaler scaler; //render scale follows the frame time, unless --render-scale fixes it
+    float renderScale = 0.0;
+    string capturePath; //record every frame into this directory
+    FrameCapture::Format captureFormat = FrameCapture::CAPTURE_PNG;
+    string recordPath, replayPath;
+    unsigned int checksumInterval = 120;
+    unsigned short hostPort = 0; //networked two-player, one side hosts and the other joins
+    string joinAddress;
+    unsigned short joinPort = 0;
+    float netLatency = 0.0, netJitter = 0.0, netLoss = 0.0; //to try it over localhost
+    unsigned short spectatePort = 0; //stream the match to spectators
+    string spectateSocket;
+    for (int i=1;i<argc;i++)
+    {
+        if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc)
+        {
+            tickRate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--balls") == 0 && i + 1 < argc) {
+            balls = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--pack") == 0 && i + 1 < argc) {
+            packPath = argv[++i];
+        } else if (strcmp(argv[i], "--no-shader-cache") == 0) {
+            Shader::CacheDirectory = ""; //always build from source
+        } else if (strcmp(argv[i], "--render-scale") == 0 && i + 1 < argc) {
+            renderScale = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--frame-budget") == 0 && i + 1 < argc) {
+            scaler.budget = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            capturePath = argv[++i];
+        } else if (strcmp(argv[i], "--capture-raw") == 0) {
+            captureFormat = FrameCapture::CAPTURE_RAW;
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--checksum-interval") == 0 && i + 1 < argc) {
+            checksumInterval = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--host") == 0 && i + 1 < argc) {
+            hostPort = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--join") == 0 && i + 1 < argc) {
+            joinAddress = argv[++i]; //ADDRESS:PORT
+            size_t colon = joinAddress.rfind(':');
+            joinPort = (colon != string::npos) ? atoi(joinAddress.c_str() + colon + 1) : 7777;
+            joinAddress = joinAddress.substr(0, colon);
+        } else if (strcmp(argv[i], "--net-latency") == 0 && i + 1 < argc) {
+            netLatency = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--net-jitter") == 0 && i + 1 < argc) {
+            netJitter = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--net-loss") == 0 && i + 1 < argc) {
+            netLoss = atof(argv[++i])/100.0f;
+        } else if (strcmp(argv[i], "--spectate-port") == 0 && i + 1 < argc) {
+            spectatePort = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--spectate-socket") == 0 && i + 1 < argc) {
+            spectateSocket = argv[++i];
+        }
+    }
+    if (renderScale > 0.0) //a fixed scale turns the controller off
+    {
+        scaler.enabled = false;
+        scaler.scale = glm::clamp(renderScale, 0.1f, 1.0f);
+    }
+    if (tickRate <= 0.0)
+    {
+        cout << "Invalid tick rate, using 120" << endl;
+        tickRate = 120.0;
+    }
+    unsigned int seed = time(NULL);
+    RollbackSession *net = nullptr;
+    if (hostPort != 0 || !joinAddress.empty()) //before the window, so the host isn't frozen while it waits
+    {
+        if (!recordPath.empty() || !replayPath.empty())
+        {
+            cout << "Recordings are single player, not recording or replaying" << endl;
+            recordPath.clear();
+            replayPath.clear();
+        }
+        net = new RollbackSession();
+        net->link.latency = netLatency;
+        net->link.jitter = netJitter;
+        net->link.loss = netLoss;
+        bool connected = (hostPort != 0) ? net->host(hostPort, seed, 1.0f/tickRate, balls) : net->join(joinAddress, joinPort);
+        if (!connected)
+            return 1;
+        seed = net->seed; //the host's settings
+        balls = net->extraBalls;
+        tickRate = 1.0f/net->dt;
+    }
+    ReplayReader *replay = nullptr;
+    if (!replayPath.empty()) //the recording decides the seed, balls and tick rate
+    {
+        replay = new ReplayReader();
+        if (!replay->open(replayPath))
+            return 1;
+        seed = replay->header.seed;
+        balls = replay->header.extraBalls;
+        tickRate = 1.0f/replay->header.dt;
+    }
+    ReplayWriter *recorder = nullptr;
+    if (!recordPath.empty())
+    {
+        recorder = new ReplayWriter();
+        float dt = replay ? replay->header.dt : 1.0f/tickRate;
+        if (!recorder->open(recordPath, seed, dt, balls, checksumInterval))
+        {
+            cout << "Couldn't write " << recordPath << endl;
+            return 1;
+        }
+    }
+
     ContextSettings settings; //Create a window
     settings.depthBits = 24;
     settings.stencilBits = 8;
     Game game(800, 600);
     game.state = GAME_MENU;
+    game.extraBalls = balls;
+    game.seed = seed;
+    game.replay = replay;
+    game.recorder = recorder;
+    game.net = net;
+    SpectatorServer spectators;
+    if (spectatePort != 0 || !spectateSocket.empty())
+    {
+        bool listening = (spectatePort == 0 || spectators.listenTcp(spectatePort));
+        listening = (spectateSocket.empty() || spectators.listenUnix(spectateSocket)) && listening;
+        if (listening && spectators.start())
+            game.spectators = &spectators;
+    }
+    game.packPath = packPath;
     Window window(VideoMode(800, 600), "Pong", Style::Default, settings);
 
     initGL(); //initialize OpenGL
-    game.init();
-
-    Clock clock; //loop
-    bool running = true;
+    {
+        PROFILE_SCOPE("init");
+        game.init();
+    }
+    game.poller.start(1000.0);
+
+    FixedTimestep timestep(tickRate, 5); //physics runs at a fixed rate, at most 5 ticks per iteration
+    if (replay)
+        timestep.dt = replay->header.dt; //exactly as recorded, 1/(1/dt) can round differently
+    if (net)
+        timestep.dt = net->dt; //same for the two sides of a networked match
+    atomic<bool> running(true);
+    thread simThread(simulate, ref(game), ref(timestep), ref(running)); //from here on only it touches game state
+
+    game.fb->SetScale(scaler.scale);
+    if (!capturePath.empty())
+        game.fb->capture = new FrameCapture(800, 600, capturePath, captureFormat);
+    unsigned long long frames = 0; //loop
     while (running)
     {
-        Event ev;
-        while (window.pollEvent(ev))
         {
-            switch(ev.type) //handle events
+            PROFILE_SCOPE("poll events");
+            Event ev;
+            while (window.pollEvent(ev))
             {
-                case Event::Closed:
-                    running = false;
-                    break;
-                case Event::KeyPressed:
-                    if (ev.key.code == Keyboard::Escape)
-                    {
+                switch(ev.type) //handle events
+                {
+                    case Event::Closed:
                         running = false;
-                    } else {
-                        game.events.push_back(ev);
-                    }
-                    break;
-                default:
-                    game.events.push_back(ev);
-                    break;
+                        break;
+                    case Event::KeyPressed:
+                        if (ev.key.code == Keyboard::Escape)
+                        {
+                            running = false;
+#ifdef PONG_PROFILE
+                        } else if (ev.key.code == Keyboard::F3) {
+                            Profiler::get().overlay = !Profiler::get().overlay;
+                            window.setTitle("Pong");
+                        } else if (ev.key.code == Keyboard::F4) {
+                            if (Profiler::get().exportTrace("trace.json"))
+                                cout << "Wrote trace.json" << endl;
+#endif
+                        } else {
+                            game.events.push(timed(ev));
+                        }
+                        break;
+                    default:
+                        game.events.push(timed(ev));
+                        break;
+                }
             }
         }
 
-        game.mousePos = vec2(Mouse::getPosition(window).x, Mouse::getPosition(window).y);
-        //update
-        game.update(clock.restart().asSeconds());
-        //render
-        game.render();
-
-        window.display();
+        //render whatever the simulation published last
+        {
+            PROFILE_SCOPE("render");
+            game.render();
+        }
+        {
+            PROFILE_SCOPE("display");
+            window.display();
+        }
+        PROFILE_COUNT("gl calls", GLState::get().issued);
+        PROFILE_COUNT("gl calls skipped", GLState::get().skipped);
+        GLState::get().endFrame();
+        PROFILE_FRAME();
+        frames++;
+        //GPU time rather than the loop's, which would also count waiting on vsync
+        float gpuMs;
+        if (game.gpuTime.result(gpuMs) && scaler.update(gpuMs)) //too slow or lots of headroom, resize for the next frame
+            game.fb->SetScale(scaler.scale);
+        PROFILE_COUNT("render scale %", (long long)(game.fb->scale*100.0f + 0.5f));
+#ifdef PONG_PROFILE
+        if (Profiler::get().overlay && frames%30 == 0) //numbers go in the title bar
+        {
+            Profiler &profiler = Profiler::get();
+            float post = 0.0; //every pass is timed on its own, see the trace for the split
+            for (unsigned int i=0;i<game.fb->passes.size();i++)
+            {
+                if (game.fb->passes[i].enabled)
+                    post += profiler.gpuTime(game.fb->passes[i].name);
+            }
+            if (game.fb->ActivePasses() == 0 && game.fb->scale != 1.0f)
+                post = profiler.gpuTime("upscale");
+            char title[200];
+            snprintf(title, sizeof(title), "Pong - p50 %.2f ms, p99 %.2f ms, scene %.2f ms, post %.2f ms GPU, %u/%u GL calls skipped, %d%% scale",
+                profiler.percentile(50), profiler.percentile(99), profiler.gpuTime("scene"), post,
+                GLState::get().lastSkipped, GLState::get().lastSkipped + GLState::get().lastIssued, (int)(game.fb->scale*100.0f + 0.5f));
+            window.setTitle(title);
+        }
+#endif
+    }
+    simThread.join();
+    if (game.spectators)
+    {
+        spectators.stop();
+        cout << spectators.framesSent << " frames sent to spectators, " << spectators.framesDropped << " dropped for slow ones" << endl;
+    }
+    if (game.fb->capture)
+    {
+        game.fb->capture->finish(); //needs the context, so before the window goes
+        cout << "captured " << game.fb->capture->written << " frames to " << capturePath << ", "
+            << game.fb->capture->dropped << " dropped" << endl;
+        delete game.fb->capture;
+        game.fb->capture = nullptr;
     }
     window.close();
+    cout << timestep.tickCount << " ticks, " << frames << " frames, "
+        << timestep.droppedTicks << " ticks dropped" << endl;
+    cout << "render scale " << game.fb->scale << " (" << scaler.changes << " changes)" << endl;
+    if (game.recorder)
+    {
+        if (game.recorder->close())
+            cout << "recorded to " << recordPath << endl;
+        else
+            cout << "Couldn't write " << recordPath << endl;
+        delete game.recorder;
+    }
+    delete game.replay;
+    if (net)
+    {
+        cout << net->rollbacks << " rollbacks, " << net->resimTicks << " ticks re-simulated (" << net->maxDepth << " deep at most), "
+            << net->resimMs << " ms re-simulating, " << net->stalls << " ticks stalled, " << net->desyncs << " desyncs" << endl;
+        delete net;
+    }
     //cin.ignore();
     //cin.ignore();
     return 0;
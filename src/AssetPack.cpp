@@ -0,0 +1,221 @@
+#include "AssetPack.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const unsigned int FORMAT_RGBA = 0x1908; //GL_RGBA, without pulling GL in here
+static const unsigned int MAX_TEXTURE_SIZE = 16384; //past what any GL takes, and keeps width*height*4 in an int
+
+AssetPack::AssetPack()
+{
+}
+
+AssetPack::~AssetPack()
+{
+    close();
+}
+
+bool AssetPack::open(const std::string &path)
+{
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    base = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    fileHandle = file;
+    mappingHandle = mapping;
+    length = (size_t)fileSize.QuadPart;
+    if (!base)
+    {
+        close();
+        return false;
+    }
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file == -1)
+        return false;
+    struct stat info;
+    if (fstat(file, &info) != 0 || info.st_size == 0)
+    {
+        ::close(file);
+        return false;
+    }
+    void *mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file); //the mapping keeps the file alive
+    if (mapped == MAP_FAILED)
+        return false;
+    base = (const unsigned char*)mapped;
+    length = info.st_size;
+#endif
+
+    //check everything up front so lookups can trust the index
+    const PackHeader *header = (const PackHeader*)base;
+    if (length < sizeof(PackHeader) || memcmp(header->magic, "PPAK", 4) != 0 || header->version != VERSION)
+    {
+        std::cout << path << " isn't a version " << VERSION << " asset pack" << std::endl;
+        close();
+        return false;
+    }
+    count = header->entryCount;
+    entries = (const PackEntry*)(base + sizeof(PackHeader));
+    if (sizeof(PackHeader) + (unsigned long long)count*sizeof(PackEntry) > length)
+    {
+        std::cout << path << " is truncated" << std::endl;
+        close();
+        return false;
+    }
+    for (unsigned int i=0;i<count;i++)
+    {
+        if (entries[i].offset > length || entries[i].size > length - entries[i].offset ||
+            memchr(entries[i].name, 0, sizeof(entries[i].name)) == NULL)
+        {
+            std::cout << path << " has a bad entry at " << i << std::endl;
+            close();
+            return false;
+        }
+        //RGBA pixels go to GL as they are, so there have to be width*height of them
+        const PackEntry &entry = entries[i];
+        if (entry.type == ASSET_TEXTURE && entry.format == FORMAT_RGBA &&
+            (entry.width == 0 || entry.height == 0 || entry.width > MAX_TEXTURE_SIZE || entry.height > MAX_TEXTURE_SIZE ||
+             (unsigned long long)entry.width*entry.height*4 > entry.size))
+        {
+            std::cout << path << " has a bad texture entry at " << i << std::endl;
+            close();
+            return false;
+        }
+        //shader source is handed to GL as a C string, the terminator after it has to be there
+        if (entry.type == ASSET_SHADER && (entry.size >= length - entry.offset || base[entry.offset + entry.size] != 0))
+        {
+            std::cout << path << " has an unterminated shader at " << i << std::endl;
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void AssetPack::close()
+{
+#ifdef _WIN32
+    if (base)
+        UnmapViewOfFile(base);
+    if (mappingHandle)
+        CloseHandle((HANDLE)mappingHandle);
+    if (fileHandle)
+        CloseHandle((HANDLE)fileHandle);
+    fileHandle = nullptr;
+    mappingHandle = nullptr;
+#else
+    if (base)
+        munmap((void*)base, length);
+#endif
+    base = nullptr;
+    length = 0;
+    entries = nullptr;
+    count = 0;
+}
+
+bool AssetPack::isOpen() const
+{
+    return base != nullptr;
+}
+
+const PackEntry *AssetPack::find(const char *name) const
+{
+    //packs hold a handful of assets and lookups happen at load time, a scan is fine
+    for (unsigned int i=0;i<count;i++)
+    {
+        if (strcmp(entries[i].name, name) == 0)
+            return &entries[i];
+    }
+    return NULL;
+}
+
+const unsigned char *AssetPack::data(const PackEntry &entry) const
+{
+    return base + entry.offset;
+}
+
+unsigned int AssetPack::entryCount() const
+{
+    return count;
+}
+
+const PackEntry &AssetPack::entry(unsigned int index) const
+{
+    return entries[index];
+}
+
+bool AssetPackWriter::add(const std::string &name, AssetType type, const void *bytes, size_t size,
+                          unsigned int format, unsigned int width, unsigned int height)
+{
+    PackEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    if (name.size() >= sizeof(entry.name))
+    {
+        std::cout << "Asset name too long: " << name << std::endl;
+        return false;
+    }
+    strcpy(entry.name, name.c_str());
+    entry.type = type;
+    entry.format = format;
+    entry.width = width;
+    entry.height = height;
+
+    while (blob.size()%AssetPack::DATA_ALIGNMENT != 0)
+        blob.push_back(0);
+    entry.offset = blob.size();
+    entry.size = size;
+    blob.insert(blob.end(), (const unsigned char*)bytes, (const unsigned char*)bytes + size);
+    if (type == ASSET_SHADER) //so the source can go to glShaderSource straight from the mapping
+        blob.push_back(0);
+    entries.push_back(entry);
+    return true;
+}
+
+bool AssetPackWriter::write(const std::string &path) const
+{
+    PackHeader header;
+    memcpy(header.magic, "PPAK", 4);
+    header.version = AssetPack::VERSION;
+    header.entryCount = entries.size();
+    header.reserved = 0;
+
+    //the data block starts aligned after the index
+    unsigned long long dataStart = sizeof(PackHeader) + entries.size()*sizeof(PackEntry);
+    unsigned long long padding = (AssetPack::DATA_ALIGNMENT - dataStart%AssetPack::DATA_ALIGNMENT)%AssetPack::DATA_ALIGNMENT;
+    dataStart += padding;
+    std::vector<PackEntry> index(entries);
+    for (unsigned int i=0;i<index.size();i++)
+        index[i].offset += dataStart;
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    unsigned char zeros[AssetPack::DATA_ALIGNMENT] = {0};
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (!index.empty())
+        ok = ok && fwrite(&index[0], sizeof(PackEntry), index.size(), file) == index.size();
+    ok = ok && fwrite(zeros, 1, padding, file) == padding;
+    if (!blob.empty())
+        ok = ok && fwrite(&blob[0], 1, blob.size(), file) == blob.size();
+    return (fclose(file) == 0) && ok;
+}
@@ -0,0 +1,39 @@
+#include "FixedTimestep.h"
+
+FixedTimestep::FixedTimestep(float tickRate, unsigned int maxSteps)
+{
+    this->maxSteps = maxSteps;
+    setTickRate(tickRate);
+}
+
+void FixedTimestep::setTickRate(float rate)
+{
+    tickRate = rate;
+    dt = 1.0f/rate;
+}
+
+unsigned int FixedTimestep::advance(float frameTime)
+{
+    frameCount++;
+    accumulator += frameTime;
+
+    unsigned long long steps = (unsigned long long)(accumulator/dt);
+    if (steps > maxSteps) { //we fell too far behind, don't try to catch up all at once
+        droppedTicks += steps - maxSteps;
+        accumulator -= steps*(double)dt;
+        steps = maxSteps;
+    } else {
+        accumulator -= steps*(double)dt;
+    }
+    if (accumulator < 0.0) { //guard against rounding
+        accumulator = 0.0;
+    }
+
+    tickCount += steps;
+    return (unsigned int)steps;
+}
+
+float FixedTimestep::alpha() const
+{
+    return (float)(accumulator/dt);
+}
@@ -0,0 +1,312 @@
+#include "FrameCapture.h"
+
+#include <cstring>
+#include <iostream>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+#include <GL/glew.h>
+#include "GLState.h"
+#include "Profiler.h"
+
+//PNG writing, just enough for screenshots: 8 bit RGBA, no filtering and "stored"
+//(uncompressed) deflate blocks, so it costs little more than a raw write
+
+static unsigned int crcTable[4][256]; //slicing by 4: one table per byte of a 32 bit word
+
+static void makeCrcTable()
+{
+    for (unsigned int n=0;n<256;n++)
+    {
+        unsigned int c = n;
+        for (int k=0;k<8;k++)
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crcTable[0][n] = c;
+    }
+    for (unsigned int n=0;n<256;n++)
+    {
+        for (int k=1;k<4;k++)
+            crcTable[k][n] = crcTable[0][crcTable[k - 1][n] & 0xFF] ^ (crcTable[k - 1][n] >> 8);
+    }
+}
+
+static unsigned int crc(const unsigned char *bytes, size_t length, unsigned int c = 0xFFFFFFFFu)
+{
+    for (;length>=4;length-=4,bytes+=4)
+    {
+        c ^= bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((unsigned int)bytes[3] << 24);
+        c = crcTable[3][c & 0xFF] ^ crcTable[2][(c >> 8) & 0xFF] ^ crcTable[1][(c >> 16) & 0xFF] ^ crcTable[0][c >> 24];
+    }
+    for (size_t i=0;i<length;i++)
+        c = crcTable[0][(c ^ bytes[i]) & 0xFF] ^ (c >> 8);
+    return c;
+}
+
+static void putBigEndian(std::vector<unsigned char> &out, unsigned int value)
+{
+    out.push_back(value >> 24);
+    out.push_back(value >> 16);
+    out.push_back(value >> 8);
+    out.push_back(value);
+}
+
+static void writeChunk(FILE *file, const char *type, const std::vector<unsigned char> &data)
+{
+    std::vector<unsigned char> header, footer;
+    putBigEndian(header, data.size());
+    header.insert(header.end(), type, type + 4);
+    unsigned int c = crc(&header[4], 4); //the CRC covers the type and the data
+    if (!data.empty())
+        c = crc(&data[0], data.size(), c);
+    putBigEndian(footer, c ^ 0xFFFFFFFFu);
+    fwrite(&header[0], 1, header.size(), file);
+    if (!data.empty())
+        fwrite(&data[0], 1, data.size(), file);
+    fwrite(&footer[0], 1, footer.size(), file);
+}
+
+static bool writePng(const char *path, int width, int height, const unsigned char *rgba) //rows bottom first
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return false;
+    static const unsigned char signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+    fwrite(signature, 1, 8, file);
+
+    std::vector<unsigned char> header;
+    putBigEndian(header, width);
+    putBigEndian(header, height);
+    header.push_back(8); //bit depth
+    header.push_back(6); //RGBA
+    header.push_back(0); //deflate
+    header.push_back(0); //no filtering
+    header.push_back(0); //not interlaced
+    writeChunk(file, "IHDR", header);
+
+    //each row is a filter byte (0, none) then the pixels, flipped so the top row comes first
+    size_t stride = (size_t)width*4;
+    std::vector<unsigned char> rows(height*(stride + 1));
+    for (int y=0;y<height;y++)
+    {
+        rows[y*(stride + 1)] = 0;
+        memcpy(&rows[y*(stride + 1) + 1], rgba + (size_t)(height - 1 - y)*stride, stride);
+    }
+
+    std::vector<unsigned char> zlib; //zlib stream of stored blocks, at most 65535 bytes each
+    zlib.reserve(rows.size() + rows.size()/65535*5 + 16);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    unsigned int a = 1, b = 0; //adler32
+    for (size_t start=0;start<rows.size();start+=65535)
+    {
+        size_t length = rows.size() - start;
+        if (length > 65535)
+            length = 65535;
+        zlib.push_back(start + length == rows.size()); //last block?
+        zlib.push_back(length & 0xFF);
+        zlib.push_back(length >> 8);
+        zlib.push_back(~length & 0xFF);
+        zlib.push_back((~length >> 8) & 0xFF);
+        zlib.insert(zlib.end(), rows.begin() + start, rows.begin() + start + length);
+        for (size_t i=start;i<start + length;) //the sums can't overflow in 5552 bytes, so only reduce that often
+        {
+            size_t end = (start + length - i > 5552) ? i + 5552 : start + length;
+            for (;i<end;i++)
+            {
+                a += rows[i];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+    }
+    putBigEndian(zlib, (b << 16) | a);
+    writeChunk(file, "IDAT", zlib);
+    writeChunk(file, "IEND", std::vector<unsigned char>());
+    return fclose(file) == 0;
+}
+
+FrameCapture::FrameCapture(int width, int height, const std::string &directory, Format format, unsigned int ringSize)
+{
+    this->width = width;
+    this->height = height;
+    this->directory = directory;
+    this->format = format;
+    if (ringSize < 2)
+        ringSize = 2;
+    makeCrcTable();
+#ifdef _WIN32
+    _mkdir(directory.c_str());
+#else
+    mkdir(directory.c_str(), 0755);
+#endif
+
+    ring.resize(ringSize);
+    for (unsigned int i=0;i<ring.size();i++)
+    {
+        glGenBuffers(1, &ring[i].pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, ring[i].pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width*height*4, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    writer = std::thread(&FrameCapture::writeLoop, this);
+}
+
+FrameCapture::~FrameCapture()
+{
+    finish();
+    for (unsigned int i=0;i<ring.size();i++)
+    {
+        if (ring[i].fence)
+            glDeleteSync(ring[i].fence);
+        glDeleteBuffers(1, &ring[i].pbo);
+    }
+    for (unsigned int i=0;i<spare.size();i++)
+        delete spare[i];
+}
+
+void FrameCapture::capture()
+{
+    if (!writer.joinable()) //finished
+        return;
+    PROFILE_SCOPE("FrameCapture::capture");
+    collect(false);
+
+    Slot &slot = ring[next];
+    bool full;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        full = (queue.size() >= maxQueued);
+    }
+    if (slot.fence || full) //still waiting on the GPU or the disk, don't make the frame wait too
+    {
+        dropped++;
+        frameNumber++;
+        return;
+    }
+
+    GLState::get().bindFramebuffer(0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0); //into the PBO, returns without waiting
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.number = frameNumber++;
+    captured++;
+    next = (next + 1)%ring.size();
+}
+
+void FrameCapture::collect(bool wait)
+{
+    for (unsigned int i=0;i<ring.size();i++)
+    {
+        Slot &slot = ring[(next + i)%ring.size()];
+        if (!slot.fence)
+            continue;
+        //the flush makes sure the fence gets to the GPU even if nothing else flushes (no swap when headless)
+        GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000000 : 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            return; //copies finish in order, nothing after this one is done either
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+
+        Frame *frame = NULL;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!spare.empty())
+            {
+                frame = spare.back();
+                spare.pop_back();
+            }
+        }
+        if (!frame)
+            frame = new Frame();
+        frame->number = slot.number;
+        frame->pixels.resize((size_t)width*height*4);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frame->pixels.size(), GL_MAP_READ_BIT);
+        if (pixels)
+        {
+            memcpy(&frame->pixels[0], pixels, frame->pixels.size());
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (pixels)
+                queue.push_back(frame);
+            else
+                spare.push_back(frame);
+        }
+        wake.notify_one();
+    }
+}
+
+void FrameCapture::finish()
+{
+    if (!writer.joinable())
+        return;
+    collect(true);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true; //the writer empties the queue before it stops
+    }
+    wake.notify_all();
+    writer.join();
+}
+
+void FrameCapture::writeLoop()
+{
+    while (true)
+    {
+        Frame *frame;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [this] { return stopping || !queue.empty(); });
+            if (queue.empty())
+                break;
+            frame = queue.front();
+            queue.pop_front();
+        }
+        bool ok = writeFrame(*frame);
+        std::lock_guard<std::mutex> guard(lock);
+        if (ok)
+            written++;
+        spare.push_back(frame);
+    }
+    if (raw)
+        fclose(raw);
+    raw = NULL;
+}
+
+bool FrameCapture::writeFrame(const Frame &frame)
+{
+    if (format == CAPTURE_PNG)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "/frame_%06llu.png", frame.number);
+        if (writePng((directory + name).c_str(), width, height, &frame.pixels[0]))
+            return true;
+        std::cout << "Couldn't write " << directory << name << std::endl;
+        return false;
+    }
+
+    if (!raw)
+    {
+        char name[48];
+        snprintf(name, sizeof(name), "/capture_%dx%d.rgba", width, height);
+        raw = fopen((directory + name).c_str(), "wb");
+        if (!raw)
+        {
+            std::cout << "Couldn't open " << directory << name << std::endl;
+            return false;
+        }
+    }
+    size_t stride = (size_t)width*4;
+    bool ok = true;
+    for (int y=height-1;y>=0;y--) //top row first
+        ok = ok && fwrite(&frame.pixels[y*stride], 1, stride, raw) == stride;
+    return ok;
+}
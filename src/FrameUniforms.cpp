@@ -0,0 +1,24 @@
+#include "FrameUniforms.h"
+
+#include <GL/glew.h>
+
+FrameUniforms::FrameUniforms()
+{
+    glGenBuffers(1, &ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, ubo); //every program's Frame block reads from here
+}
+
+FrameUniforms::~FrameUniforms()
+{
+    glDeleteBuffers(1, &ubo);
+}
+
+void FrameUniforms::upload()
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,138 @@
+#include "GLState.h"
+
+#include <GL/glew.h>
+
+static const GLuint UNKNOWN = 0xFFFFFFFF; //never a real name, so the first call always goes through
+
+GLState& GLState::get()
+{
+    static GLState state;
+    return state;
+}
+
+GLState::GLState()
+{
+    invalidate();
+}
+
+void GLState::invalidate()
+{
+    program = UNKNOWN;
+    vao = UNKNOWN;
+    fbo = UNKNOWN;
+    unit = UNKNOWN;
+    for (unsigned int i=0;i<TEXTURE_UNITS;i++)
+        textures[i] = UNKNOWN;
+    clear[0] = clear[1] = clear[2] = clear[3] = -1.0f; //clear colors are clamped to 0-1
+    blend = -1;
+    blendSrc = UNKNOWN;
+    blendDst = UNKNOWN;
+}
+
+void GLState::endFrame()
+{
+    lastSkipped = skipped;
+    lastIssued = issued;
+    skipped = 0;
+    issued = 0;
+}
+
+bool GLState::changed(bool differs)
+{
+    if (differs)
+        issued++;
+    else
+        skipped++;
+    return differs;
+}
+
+void GLState::useProgram(GLuint program)
+{
+    if (changed(this->program != program))
+    {
+        glUseProgram(program);
+        this->program = program;
+    }
+}
+
+void GLState::bindVertexArray(GLuint vao)
+{
+    if (changed(this->vao != vao))
+    {
+        glBindVertexArray(vao);
+        this->vao = vao;
+    }
+}
+
+void GLState::activeTexture(unsigned int unit)
+{
+    if (changed(this->unit != unit))
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        this->unit = unit;
+    }
+}
+
+void GLState::bindTexture(GLuint texture)
+{
+    if (unit >= TEXTURE_UNITS) //active unit unknown (or not tracked), don't guess
+    {
+        issued++;
+        glBindTexture(GL_TEXTURE_2D, texture);
+        return;
+    }
+    if (changed(textures[unit] != texture))
+    {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        textures[unit] = texture;
+    }
+}
+
+void GLState::bindTexture(unsigned int unit, GLuint texture)
+{
+    activeTexture(unit);
+    bindTexture(texture);
+}
+
+void GLState::bindFramebuffer(GLuint fbo)
+{
+    if (changed(this->fbo != fbo))
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        this->fbo = fbo;
+    }
+}
+
+void GLState::clearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+{
+    if (changed(clear[0] != r || clear[1] != g || clear[2] != b || clear[3] != a))
+    {
+        glClearColor(r, g, b, a);
+        clear[0] = r;
+        clear[1] = g;
+        clear[2] = b;
+        clear[3] = a;
+    }
+}
+
+void GLState::setBlend(bool enabled)
+{
+    if (changed(blend != (int)enabled))
+    {
+        if (enabled)
+            glEnable(GL_BLEND);
+        else
+            glDisable(GL_BLEND);
+        blend = enabled;
+    }
+}
+
+void GLState::blendFunc(GLenum src, GLenum dst)
+{
+    if (changed(blendSrc != src || blendDst != dst))
+    {
+        glBlendFunc(src, dst);
+        blendSrc = src;
+        blendDst = dst;
+    }
+}
@@ -0,0 +1,60 @@
+#include "GPUFrameTimer.h"
+
+GPUFrameTimer::GPUFrameTimer()
+{
+}
+
+GPUFrameTimer::~GPUFrameTimer()
+{
+    if (!ready)
+        return;
+    for (unsigned int i=0;i<LATENCY;i++)
+        glDeleteQueries(2, ring[i].queries);
+}
+
+void GPUFrameTimer::begin()
+{
+    if (!ready)
+    {
+        for (unsigned int i=0;i<LATENCY;i++)
+            glGenQueries(2, ring[i].queries);
+        ready = true;
+    }
+    Slot &slot = ring[next];
+    if (slot.pending) //the oldest one, it should be done by now
+        read(slot);
+    glQueryCounter(slot.queries[0], GL_TIMESTAMP);
+}
+
+void GPUFrameTimer::end()
+{
+    if (!ready)
+        return;
+    Slot &slot = ring[next];
+    glQueryCounter(slot.queries[1], GL_TIMESTAMP);
+    slot.pending = true;
+    next = (next + 1)%LATENCY;
+}
+
+void GPUFrameTimer::read(Slot &slot)
+{
+    slot.pending = false;
+    GLint available = 0;
+    glGetQueryObjectiv(slot.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) //still in flight after LATENCY frames, drop it rather than stall
+        return;
+    GLuint64 start = 0, stop = 0;
+    glGetQueryObjectui64v(slot.queries[0], GL_QUERY_RESULT, &start);
+    glGetQueryObjectui64v(slot.queries[1], GL_QUERY_RESULT, &stop);
+    latest = (stop - start)/1000000.0f;
+    fresh = true;
+}
+
+bool GPUFrameTimer::result(float &ms)
+{
+    if (!fresh)
+        return false;
+    fresh = false;
+    ms = latest;
+    return true;
+}
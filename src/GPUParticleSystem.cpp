@@ -0,0 +1,92 @@
+#include "GPUParticleSystem.h"
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include <GL/glew.h>
+#include "Shader.h"
+#include "GLState.h"
+
+const GLchar* GPUParticleSystem::VARYINGS[] = {"outPosition", "outVelocity", "outLife"};
+
+GPUParticleSystem::GPUParticleSystem(Shader updateShader, Shader renderShader, unsigned int particleNum, float lifeT)
+{
+    this->updateShader = updateShader;
+    this->renderShader = renderShader;
+    position = glm::vec2(0.0, 0.0);
+    this->particleNum = particleNum;
+    particleLife = lifeT;
+
+    std::vector<Particle> initial(particleNum);
+    for (unsigned int i=0;i<particleNum;i++) { //stagger the lifetimes so they don't all respawn together
+        initial[i].position = position;
+        initial[i].velocity = glm::vec2(0.0, 0.0);
+        initial[i].life = lifeT*(i + 1)/particleNum;
+    }
+
+    glGenVertexArrays(2, vao);
+    glGenBuffers(2, vbo);
+    for (int i=0;i<2;i++) { //two copies of the state, we read one and write the other
+        GLState::get().bindVertexArray(vao[i]);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo[i]);
+        glBufferData(GL_ARRAY_BUFFER, particleNum*sizeof(Particle), &initial[0], GL_DYNAMIC_COPY);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, velocity));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, life));
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    emitterUniform = updateShader.GetUniform<glm::vec2>("emitter");
+    ballVelUniform = updateShader.GetUniform<glm::vec2>("ballVel");
+    dtUniform = updateShader.GetUniform<GLfloat>("dt");
+    lifetimeUniform = updateShader.GetUniform<GLfloat>("lifetime");
+    renderLifetimeUniform = renderShader.GetUniform<GLfloat>("lifetime");
+    sizeUniform = renderShader.GetUniform<GLfloat>("size");
+    colorUniform = renderShader.GetUniform<glm::vec3>("color");
+}
+
+GPUParticleSystem::~GPUParticleSystem()
+{
+    glDeleteBuffers(2, vbo);
+    glDeleteVertexArrays(2, vao);
+    GLState::get().invalidate(); //the names can be handed out again
+}
+
+void GPUParticleSystem::update(float dt, glm::vec2 ballVel)
+{
+    unsigned int next = 1 - current;
+    updateShader.Use();
+    updateShader.Set(emitterUniform, position);
+    updateShader.Set(ballVelUniform, ballVel);
+    updateShader.Set(dtUniform, dt);
+    updateShader.Set(lifetimeUniform, particleLife);
+
+    glEnable(GL_RASTERIZER_DISCARD); //nothing to draw, we only want the captured outputs
+    GLState::get().bindVertexArray(vao[current]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, vbo[next]);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, particleNum);
+    glEndTransformFeedback();
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    current = next;
+}
+
+void GPUParticleSystem::render()
+{
+    renderShader.Use(); //the projection comes from the Frame block
+    renderShader.Set(renderLifetimeUniform, particleLife);
+    renderShader.Set(sizeUniform, size);
+    renderShader.Set(colorUniform, color);
+
+    GLState::get().setBlend(true);
+    GLState::get().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    GLState::get().bindVertexArray(vao[current]); //one draw for the whole system
+    glDrawArrays(GL_POINTS, 0, particleNum);
+    GLState::get().setBlend(false);
+}
@@ -0,0 +1,64 @@
+#include "InputPoller.h"
+
+#include <chrono>
+
+InputPoller::InputPoller() : running(false)
+{
+    keys[0] = sf::Keyboard::Up;
+    keys[1] = sf::Keyboard::Down;
+}
+
+InputPoller::~InputPoller()
+{
+    stop();
+}
+
+double InputPoller::now()
+{
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void InputPoller::start(float rate)
+{
+    if (running)
+        return;
+    running = true;
+    thread = std::thread(&InputPoller::pollLoop, this, rate);
+}
+
+void InputPoller::stop()
+{
+    running = false;
+    if (thread.joinable())
+        thread.join();
+}
+
+void InputPoller::pollLoop(float rate)
+{
+    std::chrono::nanoseconds interval((long long)(1e9/rate));
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    bool down[2] = {false, false};
+    while (running)
+    {
+        for (int i=0;i<2;i++)
+        {
+            //keyboard state is global in SFML, so it can be read off the window's thread
+            bool pressed = sf::Keyboard::isKeyPressed(keys[i]);
+            if (pressed == down[i])
+                continue;
+            TimedEvent ev;
+            ev.time = now();
+            ev.event.type = pressed ? sf::Event::KeyPressed : sf::Event::KeyReleased;
+            ev.event.key.code = keys[i];
+            ev.event.key.alt = ev.event.key.control = ev.event.key.shift = ev.event.key.system = false;
+            if (events.push(ev)) //if the ring is full we try again next sample
+                down[i] = pressed;
+        }
+        next += interval; //fixed schedule, a late wakeup doesn't push the rest back
+        std::chrono::steady_clock::time_point current = std::chrono::steady_clock::now();
+        if (next < current) //but after a long stall don't try to catch up
+            next = current;
+        std::this_thread::sleep_until(next);
+    }
+}
@@ -0,0 +1,135 @@
+#include "MatchEngine.h"
+
+#include <chrono>
+#include <thread>
+#include "Simulation.h"
+
+MatchEngine::MatchEngine(unsigned int threads)
+{
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    threadCount = (threads > 0) ? threads : 1;
+}
+
+EngineReport MatchEngine::run(const std::vector<unsigned int> &seeds, std::vector<MatchResult> *results)
+{
+    this->seeds = &seeds;
+    this->results = results;
+    if (results) {
+        results->assign(seeds.size(), MatchResult());
+    }
+    totals.matches = 0;
+    totals.ticks = 0;
+    totals.hits = 0;
+    totals.lost = 0;
+    totals.steals = 0;
+
+    queues = new WorkQueue[threadCount];
+    for (unsigned int i=0;i<threadCount;i++) { //give each worker a contiguous share to start with
+        size_t first = seeds.size()*i/threadCount;
+        size_t last = seeds.size()*(i + 1)/threadCount;
+        for (size_t j=first;j<last;j++) {
+            queues[i].jobs.push_back(j);
+        }
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned int i=1;i<threadCount;i++) {
+        workers.push_back(std::thread(&MatchEngine::worker, this, i));
+    }
+    worker(0); //the calling thread works too
+    for (unsigned int i=0;i<workers.size();i++) {
+        workers[i].join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    delete[] queues;
+    queues = nullptr;
+
+    EngineReport report;
+    report.threads = threadCount;
+    report.seconds = seconds;
+    report.matches = totals.matches;
+    report.ticks = totals.ticks;
+    report.hits = totals.hits;
+    report.lost = totals.lost;
+    report.steals = totals.steals;
+    if (seconds > 0.0) {
+        report.matchesPerSecond = report.matches/seconds;
+        report.ticksPerSecond = report.ticks/seconds;
+        report.ticksPerSecondPerCore = report.ticksPerSecond/threadCount;
+    }
+    return report;
+}
+
+void MatchEngine::worker(unsigned int index)
+{
+    unsigned long long matches = 0, ticks = 0, hits = 0, lost = 0, steals = 0; //local until we're done
+    unsigned int job;
+    while (true) {
+        if (!popJob(index, job)) {
+            if (!stealJob(index, job)) {
+                break; //no queue has work left and none is ever added, so we're finished
+            }
+            steals++;
+        }
+        MatchResult result = playMatch((*seeds)[job]);
+        if (results) {
+            (*results)[job] = result; //every job has its own slot, no locking needed
+        }
+        matches++;
+        ticks += result.ticks;
+        hits += result.hits;
+        lost += result.lost;
+    }
+    totals.matches.fetch_add(matches, std::memory_order_relaxed);
+    totals.ticks.fetch_add(ticks, std::memory_order_relaxed);
+    totals.hits.fetch_add(hits, std::memory_order_relaxed);
+    totals.lost.fetch_add(lost, std::memory_order_relaxed);
+    totals.steals.fetch_add(steals, std::memory_order_relaxed);
+}
+
+bool MatchEngine::popJob(unsigned int index, unsigned int &job)
+{
+    WorkQueue &q = queues[index];
+    std::lock_guard<std::mutex> guard(q.lock);
+    if (q.jobs.empty()) {
+        return false;
+    }
+    job = q.jobs.back();
+    q.jobs.pop_back();
+    return true;
+}
+
+bool MatchEngine::stealJob(unsigned int index, unsigned int &job)
+{
+    for (unsigned int i=1;i<threadCount;i++) { //try the other workers, starting with our neighbour
+        WorkQueue &q = queues[(index + i)%threadCount];
+        std::lock_guard<std::mutex> guard(q.lock);
+        if (!q.jobs.empty()) {
+            job = q.jobs.front(); //oldest end, furthest from what the owner is working on
+            q.jobs.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+MatchResult MatchEngine::playMatch(unsigned int seed)
+{
+    Simulation sim;
+    sim.reset(seed);
+    MatchResult result;
+    result.seed = seed;
+    while (!sim.lost && sim.tick < maxTicks) {
+        SimEvents events = sim.step(controller(sim), dt);
+        if (events.paddleHit) {
+            result.hits++;
+        }
+    }
+    result.ticks = sim.tick;
+    result.lost = sim.lost;
+    return result;
+}
@@ -0,0 +1,179 @@
+#include "ParticleBuffer.h"
+
+#include <cstdlib>
+#include <glm/glm.hpp>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+static float* alignedAlloc(size_t bytes)
+{
+#ifdef _WIN32
+    return (float*)_aligned_malloc(bytes, ParticleBuffer::ALIGNMENT);
+#else
+    void *p = NULL;
+    if (posix_memalign(&p, ParticleBuffer::ALIGNMENT, bytes) != 0)
+        return NULL;
+    return (float*)p;
+#endif
+}
+
+static void alignedFree(float *p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+ParticleBuffer::ParticleBuffer(unsigned int count, float lifetime, glm::vec2 emitter, glm::vec2 velocity)
+{
+    this->count = count;
+    this->capacity = (count + WIDTH - 1)/WIDTH*WIDTH;
+    this->lifetime = lifetime;
+    this->emitter = emitter;
+
+    const unsigned int fields = 11;
+    storage = alignedAlloc((size_t)fields*capacity*sizeof(float)); //one block, one array after another
+    float *p = storage;
+    posX = p; p += capacity;
+    posY = p; p += capacity;
+    scaleX = p; p += capacity;
+    scaleY = p; p += capacity;
+    alpha = p; p += capacity;
+    life = p; p += capacity;
+    colorR = p; p += capacity;
+    colorG = p; p += capacity;
+    colorB = p; p += capacity;
+    velX = p; p += capacity;
+    velY = p; p += capacity;
+
+    for (unsigned int i=0;i<capacity;i++) { //padding gets real values too so the kernels never see garbage
+        reset(i, velocity);
+    }
+}
+
+ParticleBuffer::~ParticleBuffer()
+{
+    alignedFree(storage);
+}
+
+void ParticleBuffer::reset(unsigned int index, glm::vec2 velocity)
+{
+    life[index] = lifetime;
+    alpha[index] = 1.0;
+    posX[index] = emitter.x;
+    posY[index] = emitter.y;
+    colorR[index] = 0.0;
+    colorG[index] = 0.0;
+    colorB[index] = 1.0;
+    scaleX[index] = 1.0;
+    scaleY[index] = 1.0;
+    velX[index] = -velocity.x;
+    velY[index] = -velocity.y;
+}
+
+void ParticleBuffer::update(float dt, glm::vec2 ballVel)
+{
+#if defined(__AVX__)
+    updateAVX(dt, ballVel);
+#elif defined(__SSE2__) || defined(_M_X64)
+    updateSSE(dt, ballVel);
+#else
+    updateScalar(dt, ballVel);
+#endif
+}
+
+const char* ParticleBuffer::kernelName()
+{
+#if defined(__AVX__)
+    return "avx";
+#elif defined(__SSE2__) || defined(_M_X64)
+    return "sse";
+#else
+    return "scalar";
+#endif
+}
+
+//every kernel does the same thing for each particle:
+//  life -= dt, and if it ran out the particle respawns at the emitter
+//  alpha fades with the life left
+//  the particle drifts against the ball's velocity
+//respawning is a select rather than a branch, color and scale never change
+
+void ParticleBuffer::updateScalar(float dt, glm::vec2 ballVel)
+{
+    const float invLife = 1.0f/lifetime;
+    const float dx = -ballVel.x*dt, dy = -ballVel.y*dt;
+    for (unsigned int i=0;i<capacity;i++) {
+        float l = life[i] - dt;
+        bool dead = (l <= 0.0f);
+        l = dead ? lifetime : l;
+        posX[i] = (dead ? emitter.x : posX[i]) + dx;
+        posY[i] = (dead ? emitter.y : posY[i]) + dy;
+        velX[i] = dead ? -ballVel.x : velX[i];
+        velY[i] = dead ? -ballVel.y : velY[i];
+        life[i] = l;
+        alpha[i] = l*invLife;
+    }
+}
+
+#if defined(__SSE2__) || defined(_M_X64)
+static inline __m128 select4(__m128 mask, __m128 a, __m128 b) //mask ? a : b
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+void ParticleBuffer::updateSSE(float dt, glm::vec2 ballVel)
+{
+    const __m128 vdt = _mm_set1_ps(dt);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 full = _mm_set1_ps(lifetime);
+    const __m128 invLife = _mm_set1_ps(1.0f/lifetime);
+    const __m128 ex = _mm_set1_ps(emitter.x), ey = _mm_set1_ps(emitter.y);
+    const __m128 vx = _mm_set1_ps(-ballVel.x), vy = _mm_set1_ps(-ballVel.y);
+    const __m128 dx = _mm_set1_ps(-ballVel.x*dt), dy = _mm_set1_ps(-ballVel.y*dt);
+    for (unsigned int i=0;i<capacity;i+=4) {
+        __m128 l = _mm_sub_ps(_mm_load_ps(life + i), vdt);
+        __m128 dead = _mm_cmple_ps(l, zero);
+        l = select4(dead, full, l);
+        _mm_store_ps(life + i, l);
+        _mm_store_ps(alpha + i, _mm_mul_ps(l, invLife));
+        _mm_store_ps(posX + i, _mm_add_ps(select4(dead, ex, _mm_load_ps(posX + i)), dx));
+        _mm_store_ps(posY + i, _mm_add_ps(select4(dead, ey, _mm_load_ps(posY + i)), dy));
+        _mm_store_ps(velX + i, select4(dead, vx, _mm_load_ps(velX + i)));
+        _mm_store_ps(velY + i, select4(dead, vy, _mm_load_ps(velY + i)));
+    }
+}
+#endif
+
+#if defined(__AVX__)
+void ParticleBuffer::updateAVX(float dt, glm::vec2 ballVel)
+{
+    const __m256 vdt = _mm256_set1_ps(dt);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 full = _mm256_set1_ps(lifetime);
+    const __m256 invLife = _mm256_set1_ps(1.0f/lifetime);
+    const __m256 ex = _mm256_set1_ps(emitter.x), ey = _mm256_set1_ps(emitter.y);
+    const __m256 vx = _mm256_set1_ps(-ballVel.x), vy = _mm256_set1_ps(-ballVel.y);
+    const __m256 dx = _mm256_set1_ps(-ballVel.x*dt), dy = _mm256_set1_ps(-ballVel.y*dt);
+    for (unsigned int i=0;i<capacity;i+=8) {
+        __m256 l = _mm256_sub_ps(_mm256_load_ps(life + i), vdt);
+        __m256 dead = _mm256_cmp_ps(l, zero, _CMP_LE_OQ);
+        l = _mm256_blendv_ps(l, full, dead);
+        _mm256_store_ps(life + i, l);
+        _mm256_store_ps(alpha + i, _mm256_mul_ps(l, invLife));
+        _mm256_store_ps(posX + i, _mm256_add_ps(_mm256_blendv_ps(_mm256_load_ps(posX + i), ex, dead), dx));
+        _mm256_store_ps(posY + i, _mm256_add_ps(_mm256_blendv_ps(_mm256_load_ps(posY + i), ey, dead), dy));
+        _mm256_store_ps(velX + i, _mm256_blendv_ps(_mm256_load_ps(velX + i), vx, dead));
+        _mm256_store_ps(velY + i, _mm256_blendv_ps(_mm256_load_ps(velY + i), vy, dead));
+    }
+}
+#endif
@@ -6,24 +6,20 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <GL/glew.h>
 #include "Shader.h"
+#include "GLState.h"
 
-ParticleSystem::ParticleSystem(glm::vec2 pos, Shader s, unsigned int particleNum, glm::mat4 proj, float lifeT, glm::vec2 ballVel)
+ParticleSystem::ParticleSystem(glm::vec2 pos, Shader s, unsigned int particleNum, float lifeT, glm::vec2 ballVel)
+    : particles(particleNum, lifeT, pos, ballVel) //initialize the particles
 {
     position = pos; //set up class variables
     shader = s;
-    particles = new Particle[particleNum];
-    this->proj = proj;
     this->particleNum = particleNum;
     particleLife = lifeT;
 
-    for (int i=0;i<particleNum;i++) { //initialize the particles
-        resetParticle(i, ballVel);
-    }
-
     glGenVertexArrays(1, &vao);
     glGenBuffers(1, &vbo);
 
-    glBindVertexArray(vao);
+    GLState::get().bindVertexArray(vao);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
 
     float vertices[] = {
@@ -35,59 +31,38 @@ ParticleSystem::ParticleSystem(glm::vec2 pos, Shader s, unsigned int particleNum
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
 
-    glBindVertexArray(0);
+    modelUniform = shader.GetUniform<glm::mat4>("model");
+    alphaUniform = shader.GetUniform<GLfloat>("alpha");
+    colorUniform = shader.GetUniform<glm::vec3>("color");
 }
 
 ParticleSystem::~ParticleSystem()
 {
     glDeleteBuffers(1, &vbo);
     glDeleteVertexArrays(1, &vao);
-    delete particles;
-}
-
-void ParticleSystem::resetParticle(int index, glm::vec2 velocity)
-{
-    Particle& p = particles[index];
-    p.lifetime = particleLife;
-    p.alpha = 1.0;
-    p.position = this->position;
-    p.color = glm::vec3(0.0, 0.0, 1.0);
-    p.scale = glm::vec2(1.0, 1.0);
-    p.velocity = -1.0f*velocity;
+    GLState::get().invalidate(); //the names can be handed out again
 }
 
 void ParticleSystem::update(float dt, glm::vec2 ballVel)
 {
-    for (int i=0;i<particleNum;i++) {
-        Particle& p = particles[i];
-
-        p.lifetime -= dt;
-
-        if (p.lifetime <= 0) {
-            resetParticle(i, ballVel);
-        }
-
-        p.alpha = p.lifetime/particleLife;
-        p.position += -1.0f*ballVel*dt;
-    }
+    particles.emitter = position;
+    particles.update(dt, ballVel);
 }
 
 void ParticleSystem::render()
 {
-    shader.Use(); //use the shader
-    shader.SetMatrix4("proj", proj); //set the projection matrix
+    shader.Use(); //use the shader (the projection comes from the Frame block)
+    GLState::get().bindVertexArray(vao); //same VAO for every particle
     for (int i=0;i<particleNum;i++) { //for each particle
         glm::mat4 model;
 
-        model = glm::translate(model, glm::vec3(particles[i].position, 0.0));
-        model = glm::scale(model, glm::vec3(particles[i].scale, 0.0)); //set its model matrix
+        model = glm::translate(model, glm::vec3(particles.posX[i], particles.posY[i], 0.0));
+        model = glm::scale(model, glm::vec3(particles.scaleX[i], particles.scaleY[i], 0.0)); //set its model matrix
 
-        shader.SetMatrix4("model", model); //set the particle's alpha and color
-        shader.SetFloat("alpha", particles[i].alpha);
-        shader.SetVector3f("color", particles[i].color);
+        shader.Set(modelUniform, model); //set the particle's alpha and color
+        shader.Set(alphaUniform, particles.alpha[i]);
+        shader.Set(colorUniform, glm::vec3(particles.colorR[i], particles.colorG[i], particles.colorB[i]));
 
-        glBindVertexArray(vao); //bind and draw
         glDrawArrays(GL_POINTS, 0, 1);
     }
-    glBindVertexArray(0); //unbind at the end
 }
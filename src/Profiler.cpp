@@ -0,0 +1,186 @@
+#include "Profiler.h"
+
+#ifdef PONG_PROFILE
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <GL/glew.h>
+
+static std::chrono::steady_clock::time_point profilerEpoch = std::chrono::steady_clock::now();
+
+Profiler& Profiler::get()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler()
+{
+    for (unsigned int i=0;i<HISTORY;i++) {
+        history[i] = 0.0;
+    }
+    for (unsigned int i=0;i<GPU_LATENCY;i++) {
+        timersUsed[i] = 0;
+    }
+    events.reserve(MAX_EVENTS);
+}
+
+unsigned long long Profiler::now() const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - profilerEpoch).count();
+}
+
+unsigned int Profiler::threadId()
+{
+    //called with the lock held
+    unsigned long long key = std::hash<std::thread::id>()(std::this_thread::get_id());
+    std::map<unsigned long long, unsigned int>::iterator it = threadIds.find(key);
+    if (it != threadIds.end())
+        return it->second;
+    unsigned int id = threadIds.size() + 1;
+    threadIds[key] = id;
+    return id;
+}
+
+void Profiler::record(const char *name, unsigned long long start, unsigned long long duration)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    TraceEvent e;
+    e.name = name;
+    e.start = start;
+    e.duration = duration;
+    e.thread = threadId();
+    if (events.size() < MAX_EVENTS) {
+        events.push_back(e);
+    } else {
+        events[nextEvent] = e;
+    }
+    nextEvent = (nextEvent + 1)%MAX_EVENTS;
+}
+
+void Profiler::gpuBegin(const char *name)
+{
+    if (!gpuReady) { //first use, the GL context exists by now
+        glGenQueries(GPU_LATENCY*GPU_TIMERS, &queries[0][0]);
+        gpuReady = true;
+    }
+    unsigned int slot = frameCount%GPU_LATENCY;
+    if (timersUsed[slot] >= GPU_TIMERS)
+        return;
+    GpuTimer &t = timers[slot][timersUsed[slot]];
+    t.name = name;
+    t.cpuStart = now();
+    glBeginQuery(GL_TIME_ELAPSED, queries[slot][timersUsed[slot]]);
+}
+
+void Profiler::gpuEnd()
+{
+    unsigned int slot = frameCount%GPU_LATENCY;
+    if (!gpuReady || timersUsed[slot] >= GPU_TIMERS)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    timersUsed[slot]++;
+}
+
+void Profiler::readGpuTimers(unsigned int slot)
+{
+    if (frameCount <= GPU_LATENCY) { //the very first frame's timers include driver warm-up, skip them
+        timersUsed[slot] = 0;
+        return;
+    }
+    for (unsigned int i=0;i<timersUsed[slot];i++) {
+        GLint available = 0;
+        glGetQueryObjectiv(queries[slot][i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) //still in flight after GPU_LATENCY frames, drop it rather than stall
+            continue;
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(queries[slot][i], GL_QUERY_RESULT, &ns);
+        gpuResults[timers[slot][i].name] = ns/1000000.0f;
+
+        std::lock_guard<std::mutex> guard(lock); //show it in the trace on its own row
+        TraceEvent e;
+        e.name = timers[slot][i].name;
+        e.start = timers[slot][i].cpuStart;
+        e.duration = ns/1000;
+        e.thread = 0;
+        if (events.size() < MAX_EVENTS) {
+            events.push_back(e);
+        } else {
+            events[nextEvent] = e;
+        }
+        nextEvent = (nextEvent + 1)%MAX_EVENTS;
+    }
+    timersUsed[slot] = 0;
+}
+
+void Profiler::count(const char *name, long long n)
+{
+    //counters belong to the render thread, no locking
+    frameCounters[name] += n;
+}
+
+void Profiler::endFrame()
+{
+    unsigned long long t = now();
+    if (frameCount > 0) {
+        history[frameCount%HISTORY] = (t - frameStart)/1000.0f;
+    }
+    frameStart = t;
+    lastCounters.swap(frameCounters);
+    frameCounters.clear();
+
+    frameCount++;
+    if (gpuReady) { //reuse the oldest slot, its queries should be done by now
+        readGpuTimers(frameCount%GPU_LATENCY);
+    }
+}
+
+float Profiler::frameTime(unsigned int framesAgo) const
+{
+    if (framesAgo >= HISTORY || framesAgo + 1 >= frameCount) //the first frame has no time
+        return 0.0;
+    return history[(frameCount - 1 - framesAgo)%HISTORY];
+}
+
+float Profiler::percentile(float p) const
+{
+    if (frameCount < 2)
+        return 0.0;
+    unsigned int n = (frameCount - 1 < HISTORY) ? frameCount - 1 : HISTORY;
+    std::vector<float> sorted(n);
+    for (unsigned int i=0;i<n;i++) {
+        sorted[i] = frameTime(i);
+    }
+    unsigned int k = (unsigned int)(p/100.0f*(n - 1) + 0.5f);
+    std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+    return sorted[k];
+}
+
+float Profiler::gpuTime(const char *name) const
+{
+    std::map<std::string, float>::const_iterator it = gpuResults.find(name);
+    return (it != gpuResults.end()) ? it->second : 0.0f;
+}
+
+bool Profiler::exportTrace(const char *path)
+{
+    std::ofstream out(path);
+    if (!out)
+        return false;
+    std::lock_guard<std::mutex> guard(lock);
+    out << "{\"traceEvents\":[\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}}";
+    size_t first = (events.size() < MAX_EVENTS) ? 0 : nextEvent; //oldest first
+    for (size_t i=0;i<events.size();i++) {
+        const TraceEvent &e = events[(first + i)%events.size()];
+        out << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+            << ",\"ts\":" << e.start << ",\"dur\":" << e.duration << "}";
+    }
+    out << "\n]}\n";
+    return true;
+}
+
+#endif // PONG_PROFILE
@@ -0,0 +1,180 @@
+#include "Replay.h"
+
+#include <cstring>
+#include <iostream>
+
+static unsigned char toByte(float held)
+{
+    if (held <= 0.0f)
+        return 0;
+    if (held >= 1.0f)
+        return 255;
+    return (unsigned char)(held*255.0f + 0.5f);
+}
+
+SimInput quantizeInput(const SimInput &input)
+{
+    SimInput quantized = input;
+    quantized.upHeld = toByte(input.upHeld)/255.0f;
+    quantized.downHeld = toByte(input.downHeld)/255.0f;
+    return quantized;
+}
+
+ReplayWriter::~ReplayWriter()
+{
+    close();
+}
+
+bool ReplayWriter::open(const std::string &path, unsigned int seed, float dt, unsigned int extraBalls, unsigned int checksumInterval)
+{
+    close();
+    file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    ReplayHeader header;
+    memcpy(header.magic, "PREP", 4);
+    header.version = VERSION;
+    header.seed = seed;
+    header.dt = dt;
+    header.extraBalls = extraBalls;
+    header.checksumInterval = checksumInterval;
+    this->checksumInterval = (checksumInterval != 0) ? checksumInterval : 120;
+    ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    memset(&run, 0, sizeof(run));
+    return ok;
+}
+
+void ReplayWriter::flushRun()
+{
+    if (run.ticks == 0)
+        return;
+    ok = ok && fwrite(&run, sizeof(run), 1, file) == 1;
+    run.ticks = 0;
+}
+
+void ReplayWriter::record(const SimInput &input, const Simulation &sim)
+{
+    if (!file)
+        return;
+    ReplayInput tick;
+    memset(&tick, 0, sizeof(tick));
+    tick.type = REPLAY_INPUT;
+    tick.flags = (input.up ? INPUT_UP : 0) | (input.down ? INPUT_DOWN : 0) | (input.togglePaddleColor ? INPUT_TOGGLE_COLOR : 0);
+    tick.upHeld = toByte(input.upHeld);
+    tick.downHeld = toByte(input.downHeld);
+    if (run.ticks > 0 && (run.flags != tick.flags || run.upHeld != tick.upHeld || run.downHeld != tick.downHeld))
+        flushRun();
+    if (run.ticks == 0)
+        run = tick;
+    run.ticks++;
+
+    if (sim.tick%checksumInterval == 0)
+    {
+        flushRun(); //the checksum goes after the ticks it covers
+        ReplayChecksum check;
+        memset(&check, 0, sizeof(check));
+        check.type = REPLAY_CHECKSUM;
+        check.tick = (unsigned int)sim.tick;
+        check.checksum = sim.checksum();
+        ok = ok && fwrite(&check, sizeof(check), 1, file) == 1;
+    }
+}
+
+bool ReplayWriter::close()
+{
+    if (!file)
+        return true;
+    flushRun();
+    ok = (fclose(file) == 0) && ok;
+    file = NULL;
+    return ok;
+}
+
+ReplayReader::~ReplayReader()
+{
+    close();
+}
+
+bool ReplayReader::open(const std::string &path)
+{
+    close();
+    file = fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        std::cout << "Couldn't open " << path << std::endl;
+        return false;
+    }
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, "PREP", 4) != 0 ||
+        header.version != ReplayWriter::VERSION || !(header.dt > 0.0f))
+    {
+        std::cout << path << " isn't a version " << ReplayWriter::VERSION << " replay" << std::endl;
+        close();
+        return false;
+    }
+    memset(&run, 0, sizeof(run));
+    hasPending = false;
+    checksumsChecked = 0;
+    mismatchTick = 0;
+    return true;
+}
+
+void ReplayReader::close()
+{
+    if (file)
+        fclose(file);
+    file = NULL;
+}
+
+bool ReplayReader::readRecord()
+{
+    unsigned char type;
+    if (fread(&type, 1, 1, file) != 1)
+        return false;
+    if (type == REPLAY_INPUT)
+    {
+        run.type = type;
+        return fread((unsigned char*)&run + 1, sizeof(run) - 1, 1, file) == 1;
+    }
+    if (type == REPLAY_CHECKSUM)
+    {
+        pending.type = type;
+        hasPending = fread((unsigned char*)&pending + 1, sizeof(pending) - 1, 1, file) == 1;
+        return hasPending;
+    }
+    std::cout << "Bad replay record " << (int)type << std::endl;
+    return false;
+}
+
+bool ReplayReader::next(SimInput &input)
+{
+    if (!file)
+        return false;
+    while (run.ticks == 0)
+    {
+        if (!readRecord())
+            return false;
+        hasPending = false; //a checksum verify() didn't get to, nothing to compare it with now
+    }
+    run.ticks--;
+    input = SimInput();
+    input.up = (run.flags & ReplayWriter::INPUT_UP) != 0;
+    input.down = (run.flags & ReplayWriter::INPUT_DOWN) != 0;
+    input.togglePaddleColor = (run.flags & ReplayWriter::INPUT_TOGGLE_COLOR) != 0;
+    input.upHeld = run.upHeld/255.0f;
+    input.downHeld = run.downHeld/255.0f;
+    return true;
+}
+
+bool ReplayReader::verify(const Simulation &sim)
+{
+    //checksums are only ever written where a run ends, so that's the only place to look
+    if (!file || run.ticks != 0 || !readRecord() || !hasPending)
+        return true;
+    hasPending = false;
+    checksumsChecked++;
+    if (pending.tick == (unsigned int)sim.tick && pending.checksum == sim.checksum())
+        return true;
+    if (mismatchTick == 0)
+        mismatchTick = sim.tick;
+    return false;
+}
@@ -0,0 +1,36 @@
+#include "ResolutionScaler.h"
+
+ResolutionScaler::ResolutionScaler(float budget)
+{
+    this->budget = budget;
+}
+
+bool ResolutionScaler::update(float frameTime)
+{
+    if (!enabled)
+        return false;
+    total += frameTime;
+    frames++;
+    if (frames < window)
+        return false;
+
+    float average = total/frames;
+    total = 0.0;
+    frames = 0;
+    float next = scale;
+    if (average > budget)
+    {
+        next = scale - step; //one step at a time, the next window shows whether it was enough
+    } else if (average < budget*headroom) {
+        next = scale + step;
+    }
+    if (next < minScale)
+        next = minScale;
+    if (next > maxScale)
+        next = maxScale;
+    if (next == scale)
+        return false;
+    scale = next;
+    changes++;
+    return true;
+}
@@ -0,0 +1,604 @@
+#include "RollbackSession.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include "Replay.h"
+
+static NetInput packInput(const SimInput &input)
+{
+    SimInput quantized = quantizeInput(input); //held fractions are multiples of 1/255 after this
+    NetInput packed;
+    packed.flags = (quantized.up ? ReplayWriter::INPUT_UP : 0) | (quantized.down ? ReplayWriter::INPUT_DOWN : 0) |
+        (quantized.togglePaddleColor ? ReplayWriter::INPUT_TOGGLE_COLOR : 0);
+    packed.upHeld = (unsigned char)(quantized.upHeld*255.0f + 0.5f);
+    packed.downHeld = (unsigned char)(quantized.downHeld*255.0f + 0.5f);
+    return packed;
+}
+
+static SimInput unpackInput(const NetInput &packed)
+{
+    SimInput input;
+    input.up = (packed.flags & ReplayWriter::INPUT_UP) != 0;
+    input.down = (packed.flags & ReplayWriter::INPUT_DOWN) != 0;
+    input.togglePaddleColor = (packed.flags & ReplayWriter::INPUT_TOGGLE_COLOR) != 0;
+    input.upHeld = packed.upHeld/255.0f;
+    input.downHeld = packed.downHeld/255.0f;
+    return input;
+}
+
+static bool sameInput(const NetInput &a, const NetInput &b)
+{
+    return a.flags == b.flags && a.upHeld == b.upHeld && a.downHeld == b.downHeld;
+}
+
+//the state as 4 byte words, floats by their bits, so two states are equal only if they're exactly equal
+static void putFloat(std::vector<unsigned int> &words, float value)
+{
+    unsigned int word;
+    memcpy(&word, &value, sizeof(word));
+    words.push_back(word);
+}
+
+static float getFloat(const unsigned int *&word)
+{
+    float value;
+    memcpy(&value, word++, sizeof(value));
+    return value;
+}
+
+static const unsigned int SPRITE_WORDS = 11;
+static const unsigned int STATE_WORDS = 5 + 3*SPRITE_WORDS + 3; //everything up to the extra balls
+static const unsigned int BALL_WORDS = SPRITE_WORDS + 2;
+
+static void putSprite(std::vector<unsigned int> &words, const Sprite &sprite)
+{
+    putFloat(words, sprite.position.x);
+    putFloat(words, sprite.position.y);
+    putFloat(words, sprite.rotation);
+    putFloat(words, sprite.size.x);
+    putFloat(words, sprite.size.y);
+    putFloat(words, sprite.color.x);
+    putFloat(words, sprite.color.y);
+    putFloat(words, sprite.color.z);
+    putFloat(words, sprite.previous.position.x);
+    putFloat(words, sprite.previous.position.y);
+    putFloat(words, sprite.previous.rotation);
+}
+
+static Sprite getSprite(const unsigned int *&word)
+{
+    glm::vec2 position, size;
+    position.x = getFloat(word);
+    position.y = getFloat(word);
+    float rotation = getFloat(word);
+    size.x = getFloat(word);
+    size.y = getFloat(word);
+    Sprite sprite(size, position);
+    sprite.rotation = rotation;
+    sprite.color.x = getFloat(word);
+    sprite.color.y = getFloat(word);
+    sprite.color.z = getFloat(word);
+    sprite.previous.position.x = getFloat(word);
+    sprite.previous.position.y = getFloat(word);
+    sprite.previous.rotation = getFloat(word);
+    return sprite;
+}
+
+static void writeState(const SimSnapshot &state, std::vector<unsigned int> &words)
+{
+    words.clear();
+    words.push_back((unsigned int)state.tick);
+    words.push_back((unsigned int)(state.tick >> 32));
+    words.push_back(state.rngState);
+    words.push_back(state.lost ? 1 : 0);
+    words.push_back((unsigned int)state.loser);
+    putSprite(words, state.paddle);
+    putSprite(words, state.paddle2);
+    putSprite(words, state.ball);
+    putFloat(words, state.ballVel.x);
+    putFloat(words, state.ballVel.y);
+    words.push_back(state.balls.size());
+    for (unsigned int i=0;i<state.balls.size();i++)
+    {
+        putSprite(words, state.balls[i]);
+        putFloat(words, state.ballVels[i].x);
+        putFloat(words, state.ballVels[i].y);
+    }
+}
+
+static bool readState(const std::vector<unsigned int> &words, SimSnapshot &state)
+{
+    if (words.size() < STATE_WORDS)
+        return false;
+    size_t balls = words[STATE_WORDS - 1]; //in size_t, so a made up count can't wrap around to fit
+    if (balls > (words.size() - STATE_WORDS)/BALL_WORDS || words.size() != STATE_WORDS + balls*BALL_WORDS)
+        return false;
+    const unsigned int *word = &words[0];
+    state.tick = word[0] | ((unsigned long long)word[1] << 32);
+    state.rngState = word[2];
+    state.lost = (word[3] != 0);
+    state.loser = (int)word[4];
+    word += 5;
+    state.paddle = getSprite(word);
+    state.paddle2 = getSprite(word);
+    state.ball = getSprite(word);
+    state.ballVel.x = getFloat(word);
+    state.ballVel.y = getFloat(word);
+    unsigned int count = *word++;
+    state.balls.clear();
+    state.ballVels.clear();
+    for (unsigned int i=0;i<count;i++)
+    {
+        state.balls.push_back(getSprite(word));
+        glm::vec2 vel;
+        vel.x = getFloat(word);
+        vel.y = getFloat(word);
+        state.ballVels.push_back(vel);
+    }
+    return true;
+}
+
+//XOR against the base (bytes that didn't change become zero), then run-length code the
+//zeros: a byte of zeros to skip, a byte of literals to copy, the literals, repeat
+static void encodeDelta(const std::vector<unsigned int> &words, const std::vector<unsigned int> *base, std::vector<unsigned char> &out)
+{
+    const unsigned char *bytes = (const unsigned char*)&words[0];
+    const unsigned char *baseBytes = base ? (const unsigned char*)&(*base)[0] : NULL;
+    size_t size = words.size()*sizeof(unsigned int);
+    size_t i = 0;
+    while (i < size)
+    {
+        unsigned int zeros = 0;
+        while (i < size && zeros < 255 && (bytes[i] ^ (baseBytes ? baseBytes[i] : 0)) == 0)
+        {
+            zeros++;
+            i++;
+        }
+        //a lone zero is cheaper to copy than to end the literals for
+        size_t start = i;
+        unsigned int literals = 0;
+        while (i < size && literals < 255)
+        {
+            bool zero = (bytes[i] ^ (baseBytes ? baseBytes[i] : 0)) == 0;
+            bool nextZero = (i + 1 == size) || (bytes[i + 1] ^ (baseBytes ? baseBytes[i + 1] : 0)) == 0;
+            if (zero && nextZero)
+                break;
+            literals++;
+            i++;
+        }
+        out.push_back(zeros);
+        out.push_back(literals);
+        for (size_t j=start;j<start + literals;j++)
+            out.push_back(bytes[j] ^ (baseBytes ? baseBytes[j] : 0));
+    }
+}
+
+static bool decodeDelta(const unsigned char *data, size_t size, const std::vector<unsigned int> *base,
+                        unsigned int count, std::vector<unsigned int> &words)
+{
+    words.assign(count, 0);
+    if (base && base->size() != count)
+        return false;
+    unsigned char *bytes = count ? (unsigned char*)&words[0] : NULL;
+    size_t length = count*sizeof(unsigned int);
+    size_t i = 0, p = 0;
+    while (p + 2 <= size)
+    {
+        unsigned int zeros = data[p], literals = data[p + 1];
+        p += 2;
+        if (i + zeros + literals > length || p + literals > size)
+            return false;
+        i += zeros;
+        memcpy(bytes + i, data + p, literals);
+        i += literals;
+        p += literals;
+    }
+    if (p != size)
+        return false;
+    if (base)
+    {
+        for (unsigned int w=0;w<count;w++)
+            words[w] ^= (*base)[w];
+    }
+    return true;
+}
+
+RollbackSession::RollbackSession()
+{
+    incoming.resize(UdpLink::MAX_PACKET);
+}
+
+bool RollbackSession::host(unsigned short port, unsigned int seed, float dt, unsigned int extraBalls, double timeout)
+{
+    player = 0;
+    this->seed = seed;
+    this->dt = dt;
+    this->extraBalls = extraBalls;
+    if (!link.listen(port))
+        return false;
+    std::cout << "Waiting for player 2 on UDP port " << port << std::endl;
+    double start = UdpLink::now();
+    while (UdpLink::now() - start < timeout)
+    {
+        int got = link.receive(&incoming[0], incoming.size());
+        if (got >= (int)sizeof(NetHello) && incoming[0] == NET_HELLO)
+        {
+            if (incoming[1] != VERSION)
+            {
+                std::cout << "Player 2 has network version " << (int)incoming[1] << ", not " << VERSION << std::endl;
+                return false;
+            }
+            sendWelcome();
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::cout << "Nobody joined" << std::endl;
+    return false;
+}
+
+bool RollbackSession::join(const std::string &address, unsigned short port, double timeout)
+{
+    player = 1;
+    if (!link.connect(address, port))
+        return false;
+    double start = UdpLink::now();
+    double lastHello = -1.0;
+    while (UdpLink::now() - start < timeout)
+    {
+        if (UdpLink::now() - lastHello > 0.1) //the hello or the welcome can get lost, keep asking
+        {
+            NetHello hello;
+            memset(&hello, 0, sizeof(hello));
+            hello.type = NET_HELLO;
+            hello.version = VERSION;
+            link.send(&hello, sizeof(hello));
+            lastHello = UdpLink::now();
+        }
+        int got = link.receive(&incoming[0], incoming.size());
+        if (got >= (int)sizeof(NetWelcome) && incoming[0] == NET_WELCOME)
+        {
+            NetWelcome welcome;
+            memcpy(&welcome, &incoming[0], sizeof(welcome));
+            if (welcome.version != VERSION)
+            {
+                std::cout << "The host has network version " << (int)welcome.version << ", not " << VERSION << std::endl;
+                return false;
+            }
+            seed = welcome.seed;
+            dt = welcome.dt;
+            extraBalls = welcome.extraBalls;
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::cout << "No answer from " << address << ":" << port << std::endl;
+    return false;
+}
+
+void RollbackSession::start(Simulation &sim)
+{
+    this->sim = &sim;
+    sim.twoPlayer = true;
+    sim.reset(seed);
+    sim.addBalls(extraBalls);
+
+    NetInput idle = packInput(SimInput());
+    for (unsigned int i=0;i<HISTORY;i++)
+    {
+        local[i] = idle;
+        remote[i] = idle;
+        used[i] = idle;
+    }
+    remoteConfirmed = 0;
+    remoteLatest = 0;
+    peerAck = 0;
+    remoteAdvantage = 0;
+    lastWait = 0;
+    nextSync = syncInterval;
+    stateAck = 0;
+    checkPending = false;
+}
+
+bool RollbackSession::advance(const SimInput &input, SimEvents &events)
+{
+    poll();
+    unsigned long long next = sim->tick + 1;
+    if (next > remoteConfirmed + maxRollback) //guessing any further would make rollbacks too deep
+    {
+        stalls++;
+        sendInputs(); //maybe ours got lost and they're waiting too
+        return false;
+    }
+    //if we're further ahead of them than they are of us, sit out the odd tick so they
+    //can catch up, otherwise they'd keep correcting for inputs that arrive late
+    long long advantage = (long long)sim->tick - (long long)remoteLatest;
+    if ((advantage - remoteAdvantage)/2 >= 2 && sim->tick >= lastWait + 10)
+    {
+        lastWait = sim->tick;
+        waits++;
+        sendInputs();
+        return false;
+    }
+
+    local[next%HISTORY] = packInput(input);
+    events = stepTick(next);
+    sendInputs();
+    if (player == 0)
+        sendState();
+    return true;
+}
+
+void RollbackSession::poll()
+{
+    if (!sim)
+        return;
+    unsigned long long firstWrong = 0; //earliest tick a guess turned out wrong
+    int got;
+    while ((got = link.receive(&incoming[0], incoming.size())) > 0)
+    {
+        switch (incoming[0])
+        {
+            case NET_HELLO:
+                if (player == 0) //they missed the welcome
+                    sendWelcome();
+                break;
+            case NET_INPUT:
+                receiveInputs(&incoming[0], got, firstWrong);
+                break;
+            case NET_STATE:
+                if (player == 1)
+                    receiveState(&incoming[0], got);
+                break;
+        }
+    }
+    if (firstWrong != 0)
+        resimulate(firstWrong, snapshots[firstWrong%HISTORY]);
+    if (checkPending)
+        checkState();
+}
+
+void RollbackSession::idle()
+{
+    if (!sim)
+        return;
+    poll();
+    sendInputs();
+}
+
+void RollbackSession::endFrame()
+{
+    if (frameResimMs > dt*1000.0f)
+        overBudget++;
+    maxResimMs = std::max(maxResimMs, frameResimMs);
+    lastDepth = frameDepth;
+    lastResimTicks = frameResimTicks;
+    lastResimMs = frameResimMs;
+    frameDepth = 0;
+    frameResimTicks = 0;
+    frameResimMs = 0.0;
+}
+
+SimEvents RollbackSession::stepTick(unsigned long long tick)
+{
+    unsigned int slot = tick%HISTORY;
+    sim->save(snapshots[slot]);
+    used[slot] = (tick <= remoteConfirmed) ? remote[slot] : predict();
+    SimInput mine = unpackInput(local[slot]);
+    SimInput theirs = unpackInput(used[slot]);
+    if (player == 0)
+        return sim->step(mine, theirs, dt);
+    return sim->step(theirs, mine, dt);
+}
+
+void RollbackSession::resimulate(unsigned long long from, const SimSnapshot &before)
+{
+    //events from the re-simulated ticks are dropped, their effects already played the first time
+    unsigned long long to = sim->tick;
+    double start = UdpLink::now();
+    sim->restore(before);
+    for (unsigned long long tick=from;tick<=to;tick++)
+        stepTick(tick);
+    double ms = (UdpLink::now() - start)*1000.0;
+
+    unsigned int depth = to - from + 1;
+    rollbacks++;
+    resimTicks += depth;
+    resimMs += ms;
+    maxDepth = std::max(maxDepth, depth);
+    frameDepth = std::max(frameDepth, depth);
+    frameResimTicks += depth;
+    frameResimMs += ms;
+}
+
+NetInput RollbackSession::predict() const
+{
+    NetInput guess = remote[remoteConfirmed%HISTORY]; //they're probably still doing what they last did
+    guess.flags &= ~ReplayWriter::INPUT_TOGGLE_COLOR; //but a click doesn't repeat
+    return guess;
+}
+
+bool RollbackSession::stateAfter(unsigned long long tick, std::vector<unsigned int> &words)
+{
+    if (tick == sim->tick)
+    {
+        sim->save(live);
+        writeState(live, words);
+        return true;
+    }
+    if (tick < sim->tick && tick + HISTORY > sim->tick) //the snapshot before the next tick
+    {
+        writeState(snapshots[(tick + 1)%HISTORY], words);
+        return true;
+    }
+    return false;
+}
+
+void RollbackSession::sendWelcome()
+{
+    NetWelcome welcome;
+    memset(&welcome, 0, sizeof(welcome));
+    welcome.type = NET_WELCOME;
+    welcome.version = VERSION;
+    welcome.seed = seed;
+    welcome.dt = dt;
+    welcome.extraBalls = extraBalls;
+    link.send(&welcome, sizeof(welcome));
+}
+
+void RollbackSession::sendInputs()
+{
+    //everything they haven't acked, a lost packet is covered by the next one
+    unsigned long long last = sim->tick;
+    unsigned long long first = peerAck + 1;
+    if (last + 1 > first + MAX_INPUTS)
+        first = last + 1 - MAX_INPUTS;
+    unsigned int count = (last >= first) ? last - first + 1 : 0;
+
+    NetInputHeader header;
+    memset(&header, 0, sizeof(header));
+    header.type = NET_INPUT;
+    header.count = count;
+    long long advantage = (long long)sim->tick - (long long)remoteLatest;
+    header.advantage = (signed char)std::max(-127LL, std::min(127LL, advantage));
+    header.firstTick = first;
+    header.ack = remoteConfirmed;
+    header.stateAck = (player == 1) ? stateAck : 0;
+
+    packet.resize(sizeof(header) + count*sizeof(NetInput));
+    memcpy(&packet[0], &header, sizeof(header));
+    for (unsigned int i=0;i<count;i++)
+        memcpy(&packet[sizeof(header) + i*sizeof(NetInput)], &local[(first + i)%HISTORY], sizeof(NetInput));
+    link.send(&packet[0], packet.size());
+}
+
+void RollbackSession::receiveInputs(const unsigned char *data, int size, unsigned long long &firstWrong)
+{
+    NetInputHeader header;
+    if (size < (int)sizeof(header))
+        return;
+    memcpy(&header, data, sizeof(header));
+    if (size < (int)(sizeof(header) + header.count*sizeof(NetInput)))
+        return;
+
+    for (unsigned int i=0;i<header.count;i++)
+    {
+        unsigned long long tick = (unsigned long long)header.firstTick + i;
+        if (tick <= remoteConfirmed) //had it already
+            continue;
+        if (tick != remoteConfirmed + 1) //a gap, an older packet got here late
+            break;
+        NetInput input;
+        memcpy(&input, data + sizeof(header) + i*sizeof(NetInput), sizeof(input));
+        remote[tick%HISTORY] = input;
+        remoteConfirmed = tick;
+        if (tick <= sim->tick && !sameInput(used[tick%HISTORY], input) && (firstWrong == 0 || tick < firstWrong))
+            firstWrong = tick; //stepped with a wrong guess
+    }
+    if (header.count > 0)
+        remoteLatest = std::max(remoteLatest, (unsigned long long)header.firstTick + header.count - 1);
+    peerAck = std::max(peerAck, (unsigned long long)header.ack);
+    remoteAdvantage = header.advantage;
+    if (player == 0)
+        stateAck = std::max(stateAck, header.stateAck);
+}
+
+void RollbackSession::sendState()
+{
+    //the state is only final once both inputs are in, send the newest one that's due
+    unsigned long long newest = std::min(remoteConfirmed, sim->tick);
+    if (syncInterval == 0 || newest < nextSync)
+        return;
+    unsigned long long tick = newest - newest%syncInterval;
+    nextSync = tick + syncInterval;
+    if (!stateAfter(tick, scratch))
+        return;
+
+    const SentState *base = NULL; //the newest state the client has, if we still have it too
+    for (unsigned int i=0;i<STATE_HISTORY;i++)
+    {
+        if (stateAck != 0 && states[i].tick == stateAck && i != stateSlot && states[i].words.size() == scratch.size())
+            base = &states[i];
+    }
+
+    NetStateHeader header;
+    memset(&header, 0, sizeof(header));
+    header.type = NET_STATE;
+    header.tick = tick;
+    header.baseTick = base ? base->tick : 0;
+    header.words = scratch.size();
+    packet.resize(sizeof(header));
+    memcpy(&packet[0], &header, sizeof(header));
+    encodeDelta(scratch, base ? &base->words : NULL, packet);
+    if (packet.size() > UdpLink::MAX_PACKET) //too many balls to send in one go, rely on determinism
+        return;
+    link.send(&packet[0], packet.size());
+
+    states[stateSlot].tick = tick;
+    states[stateSlot].words = scratch;
+    stateSlot = (stateSlot + 1)%STATE_HISTORY;
+    statesSent++;
+    stateBytes += packet.size();
+    fullStateBytes += sizeof(header) + scratch.size()*sizeof(unsigned int);
+}
+
+void RollbackSession::receiveState(const unsigned char *data, int size)
+{
+    NetStateHeader header;
+    if (size < (int)sizeof(header))
+        return;
+    memcpy(&header, data, sizeof(header));
+    if (header.tick <= stateAck) //old or repeated
+        return;
+    const SentState *base = NULL;
+    if (header.baseTick != 0)
+    {
+        for (unsigned int i=0;i<STATE_HISTORY;i++)
+        {
+            if (states[i].tick == header.baseTick)
+                base = &states[i];
+        }
+        if (!base) //already dropped it, the host will send one against a newer base
+            return;
+    }
+    //each 2 byte run header expands to at most 255 zeros and 255 literals, so anything claiming
+    //more words than that is garbage, check before decodeDelta() allocates them
+    size_t payload = size - sizeof(header);
+    if ((unsigned long long)header.words*sizeof(unsigned int) > (unsigned long long)(payload/2)*510)
+        return;
+    if (!decodeDelta(data + sizeof(header), payload, base ? &base->words : NULL, header.words, scratch))
+        return;
+
+    states[stateSlot].tick = header.tick;
+    states[stateSlot].words = scratch;
+    stateSlot = (stateSlot + 1)%STATE_HISTORY;
+    stateAck = header.tick;
+    statesReceived++;
+    checkPending = true;
+}
+
+void RollbackSession::checkState()
+{
+    if (stateAck > remoteConfirmed || stateAck > sim->tick) //ours isn't final yet
+        return;
+    checkPending = false;
+    const SentState *hosted = NULL;
+    for (unsigned int i=0;i<STATE_HISTORY;i++)
+    {
+        if (states[i].tick == stateAck)
+            hosted = &states[i];
+    }
+    if (!hosted || !stateAfter(stateAck, scratch) || scratch == hosted->words)
+        return;
+
+    //we went a different way somewhere, take the host's state and redo the ticks after it
+    SimSnapshot fixed;
+    if (!readState(hosted->words, fixed))
+        return;
+    desyncs++;
+    std::cout << "Desync at tick " << stateAck << ", using the host's state" << std::endl;
+    resimulate(stateAck + 1, fixed);
+}
@@ -0,0 +1,306 @@
+#include "Simulation.h"
+
+#include <cmath>
+#include <glm/glm.hpp>
+#include "Sprite.h"
+
+Simulation::Simulation(int width, int height)
+    : paddle(glm::vec2(45, 130)), ball(glm::vec2(70, 70)), paddle2(glm::vec2(45, 130))
+{
+    this->width = width;
+    this->height = height;
+    reset(1);
+}
+
+unsigned int Simulation::nextRandom()
+{
+    //xorshift32, the same on every platform unlike rand()
+    unsigned int x = rngState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rngState = x;
+    return x;
+}
+
+int Simulation::randUInt(int rmin, int rmax)
+{
+    int mod = rmax - rmin + 1;
+    int randint = (nextRandom()%mod) + rmin;
+    return randint;
+}
+
+void Simulation::reset(unsigned int seed)
+{
+    rngState = (seed != 0) ? seed : 0x9E3779B9; //xorshift gets stuck on zero
+    tick = 0;
+    lost = false;
+    loser = 0;
+    balls.clear();
+    ballVels.clear();
+    ballPairs.clear();
+    ballContacts = 0;
+
+    paddle = Sprite(glm::vec2(45, 130), glm::vec2(30, 20));
+    paddle.color = glm::vec3(0.0f, 1.0f, 0.0f); //player 1
+    paddle2 = Sprite(glm::vec2(45, 130), glm::vec2(width - 30 - 45, 20));
+    paddle2.color = glm::vec3(0.2f, 0.6f, 1.0f); //player 2
+
+    ball = Sprite(glm::vec2(70, 70), glm::vec2(randUInt(70, 700), randUInt(70, 500)));
+    float magnitude = randUInt(600, 900);
+    int ang = randUInt(25, 70);
+    ballVel = glm::vec2(magnitude * cos(ang), magnitude*sin(ang));
+}
+
+SimEvents Simulation::step(const SimInput &input, float dt)
+{
+    return step(input, SimInput(), dt);
+}
+
+SimEvents Simulation::step(const SimInput &input, const SimInput &input2, float dt)
+{
+    SimEvents events;
+    tick++;
+    paddle.savePrevious(); //so the renderer can blend from here to where this tick ends up
+    paddle2.savePrevious();
+    ball.savePrevious();
+    for (unsigned int i=0;i<balls.size();i++)
+        balls[i].savePrevious();
+
+    movePaddle(paddle, input, glm::vec3(0.0, 1.0, 0.0), dt);
+    if (twoPlayer)
+        movePaddle(paddle2, input2, glm::vec3(0.2, 0.6, 1.0), dt);
+
+    if (lost)
+        return events;
+
+    moveBall(ball, ballVel, dt, true, events);
+    for (unsigned int i=0;i<balls.size();i++)
+        moveBall(balls[i], ballVels[i], dt, false, events);
+    if (!balls.empty())
+        collideBalls();
+    return events;
+}
+
+void Simulation::movePaddle(Sprite &sprite, const SimInput &input, glm::vec3 color, float dt)
+{
+    if (input.togglePaddleColor && !lost)
+    {
+        sprite.color = (sprite.color == color) ?
+        glm::vec3(1.0, 0.6666, 0.98) : color;
+    }
+
+    if (input.up) //handle input
+    {
+        if ((sprite.position.y >= 0.0f) && (!lost))
+        {
+            sprite.position.y -= paddleSpeed*dt*input.upHeld;
+        }
+    }
+    if (input.down)
+    {
+        if ((sprite.position.y + sprite.size.y <= height) && (!lost))
+        {
+            sprite.position.y += paddleSpeed*dt*input.downHeld;
+        }
+    }
+}
+
+void Simulation::moveBall(Sprite &sprite, glm::vec2 &vel, float dt, bool mainBall, SimEvents &events)
+{
+    //sweep the ball along its whole motion for this tick so it can't tunnel through
+    //the paddle or a wall at high speeds or big timesteps, bouncing as often as needed
+    glm::vec2 center = sprite.position + (0.5f*sprite.size);
+    float radius = 0.5f*sprite.size.x;
+    glm::vec2 motion = vel*dt;
+    float remaining = 1.0f; //fraction of the tick the ball still has to travel
+    int bounce = 0;
+    for (;bounce<MAX_BOUNCES;bounce++)
+    {
+        Contact walls[4] = {
+            sweepCirclePlane(center, radius, motion, glm::vec2(1.0, 0.0), 0.0f), //left, behind the paddle
+            sweepCirclePlane(center, radius, motion, glm::vec2(-1.0, 0.0), -width),
+            sweepCirclePlane(center, radius, motion, glm::vec2(0.0, 1.0), 0.0f),
+            sweepCirclePlane(center, radius, motion, glm::vec2(0.0, -1.0), -height)
+        };
+        Contact first = sweepCircleAABB(center, radius, motion, paddle);
+        int hitWall = -1; //-1 is a paddle
+        if (twoPlayer)
+        {
+            Contact second = sweepCircleAABB(center, radius, motion, paddle2);
+            if (second.hit && (!first.hit || second.time < first.time))
+                first = second;
+        }
+        for (int i=0;i<4;i++)
+        {
+            if (walls[i].hit && (!first.hit || walls[i].time < first.time))
+            {
+                first = walls[i];
+                hitWall = i;
+            }
+        }
+        if (!first.hit)
+            break;
+
+        center += first.time*motion;
+        if ((hitWall == 0 || (hitWall == 1 && twoPlayer)) && mainBall)
+        {
+            lost = true;
+            loser = (hitWall == 0) ? 1 : 2;
+            events.ballLost = true;
+            motion = glm::vec2(0.0, 0.0);
+            break;
+        }
+        if (hitWall == -1 && mainBall)
+            events.paddleHit = true;
+
+        //reflect off the surface and spend what is left of the motion in the new direction
+        vel -= 2.0f*glm::dot(vel, first.normal)*first.normal;
+        remaining *= (1.0f - first.time);
+        motion = vel*dt*remaining;
+    }
+    if (bounce < MAX_BOUNCES) //out of bounces means it's wedged somewhere, better to stop there than to tunnel
+        center += motion;
+    sprite.position = center - (0.5f*sprite.size);
+
+    if (!lost)
+        sprite.rotate(dt); //spin ball
+}
+
+void Simulation::addBalls(unsigned int count, float diameter)
+{
+    for (unsigned int i=0;i<count;i++)
+    {
+        Sprite extra(glm::vec2(diameter, diameter), glm::vec2(randUInt(100, width - diameter), randUInt(0, height - diameter)));
+        extra.color = glm::vec3(randUInt(30, 100)/100.0f, randUInt(30, 100)/100.0f, randUInt(30, 100)/100.0f);
+        balls.push_back(extra);
+        float magnitude = randUInt(200, 500);
+        int ang = randUInt(0, 359);
+        ballVels.push_back(glm::vec2(magnitude * cos(ang), magnitude*sin(ang)));
+    }
+    broadphase.cellSize = 2.0f*diameter; //most balls then sit in one or two cells
+}
+
+void Simulation::collideBalls()
+{
+    //broadphase over every ball, the main one gets the last id
+    unsigned int mainId = balls.size();
+    broadphase.clear();
+    for (unsigned int i=0;i<balls.size();i++)
+        broadphase.insert(i, balls[i]);
+    broadphase.insert(mainId, ball);
+    broadphase.findPairs(ballPairs);
+
+    ballContacts = 0;
+    for (unsigned int p=0;p<ballPairs.size();p++)
+    {
+        Sprite &a = (ballPairs[p].first == mainId) ? ball : balls[ballPairs[p].first];
+        Sprite &b = (ballPairs[p].second == mainId) ? ball : balls[ballPairs[p].second];
+        glm::vec2 &velA = (ballPairs[p].first == mainId) ? ballVel : ballVels[ballPairs[p].first];
+        glm::vec2 &velB = (ballPairs[p].second == mainId) ? ballVel : ballVels[ballPairs[p].second];
+
+        RSprite circleA(0.5f*a.size.x, a.position), circleB(0.5f*b.size.x, b.position);
+        if (!checkCollision(circleA, circleB)) //narrowphase
+            continue;
+        glm::vec2 offset = (circleB.position + circleB.radius) - (circleA.position + circleA.radius);
+        float distance = glm::length(offset);
+        if (distance == 0.0f) //exactly on top of each other, no way to tell which way to push
+            continue;
+        float overlap = circleA.radius + circleB.radius - distance;
+        ballContacts++;
+
+        //push apart evenly, then swap the velocity along the normal if they're closing (equal masses)
+        glm::vec2 normal = offset/distance;
+        a.position -= (0.5f*overlap)*normal;
+        b.position += (0.5f*overlap)*normal;
+        float closing = glm::dot(velA - velB, normal);
+        if (closing > 0.0f)
+        {
+            velA -= closing*normal;
+            velB += closing*normal;
+        }
+    }
+}
+
+//FNV-1a, over the exact bits so any difference at all shows up
+static void hashBytes(unsigned long long &hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char*)data;
+    for (size_t i=0;i<size;i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+}
+
+static void hashSprite(unsigned long long &hash, const Sprite &sprite)
+{
+    hashBytes(hash, &sprite.position, sizeof(sprite.position));
+    hashBytes(hash, &sprite.rotation, sizeof(sprite.rotation));
+    hashBytes(hash, &sprite.size, sizeof(sprite.size));
+}
+
+unsigned long long Simulation::checksum() const
+{
+    unsigned long long hash = 0xCBF29CE484222325ull;
+    hashBytes(hash, &tick, sizeof(tick));
+    hashBytes(hash, &rngState, sizeof(rngState));
+    hashBytes(hash, &lost, sizeof(lost));
+    hashSprite(hash, paddle);
+    hashSprite(hash, ball);
+    hashBytes(hash, &ballVel, sizeof(ballVel));
+    for (unsigned int i=0;i<balls.size();i++)
+    {
+        hashSprite(hash, balls[i]);
+        hashBytes(hash, &ballVels[i], sizeof(ballVels[i]));
+    }
+    if (twoPlayer)
+    {
+        hashSprite(hash, paddle2);
+        hashBytes(hash, &loser, sizeof(loser));
+    }
+    return hash;
+}
+
+void Simulation::save(SimSnapshot &snapshot) const
+{
+    snapshot.tick = tick;
+    snapshot.rngState = rngState;
+    snapshot.lost = lost;
+    snapshot.loser = loser;
+    snapshot.paddle = paddle;
+    snapshot.paddle2 = paddle2;
+    snapshot.ball = ball;
+    snapshot.ballVel = ballVel;
+    snapshot.balls.assign(balls.begin(), balls.end()); //no allocation once the snapshot has been used
+    snapshot.ballVels.assign(ballVels.begin(), ballVels.end());
+}
+
+void Simulation::restore(const SimSnapshot &snapshot)
+{
+    tick = snapshot.tick;
+    rngState = snapshot.rngState;
+    lost = snapshot.lost;
+    loser = snapshot.loser;
+    paddle = snapshot.paddle;
+    paddle2 = snapshot.paddle2;
+    ball = snapshot.ball;
+    ballVel = snapshot.ballVel;
+    balls.assign(snapshot.balls.begin(), snapshot.balls.end());
+    ballVels.assign(snapshot.ballVels.begin(), snapshot.ballVels.end());
+}
+
+SimInput trackBall(const Simulation &sim)
+{
+    return trackBall(sim, sim.paddle);
+}
+
+SimInput trackBall(const Simulation &sim, const Sprite &paddle)
+{
+    SimInput input;
+    float paddleCenter = paddle.position.y + 0.5f*paddle.size.y;
+    float ballCenter = sim.ball.position.y + 0.5f*sim.ball.size.y;
+    input.up = (ballCenter < paddleCenter - 10.0f);
+    input.down = (ballCenter > paddleCenter + 10.0f);
+    return input;
+}
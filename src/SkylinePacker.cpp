@@ -0,0 +1,102 @@
+#include "SkylinePacker.h"
+
+SkylinePacker::SkylinePacker(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+    reset();
+}
+
+void SkylinePacker::reset()
+{
+    skyline.clear();
+    Segment floor;
+    floor.x = 0;
+    floor.y = 0;
+    floor.width = width;
+    skyline.push_back(floor);
+    usedArea = 0;
+}
+
+float SkylinePacker::occupancy() const
+{
+    return (float)usedArea/((float)width*height);
+}
+
+bool SkylinePacker::fits(unsigned int index, int w, int h, int &y) const
+{
+    //a rectangle starting at this segment rests on the highest segment under it
+    int x = skyline[index].x;
+    if (x + w > width)
+        return false;
+    y = 0;
+    int remaining = w;
+    for (unsigned int i=index;remaining > 0;i++)
+    {
+        if (skyline[i].y > y)
+            y = skyline[i].y;
+        if (y + h > height)
+            return false;
+        remaining -= skyline[i].width;
+    }
+    return true;
+}
+
+bool SkylinePacker::pack(int w, int h, int &x, int &y)
+{
+    if (w <= 0 || h <= 0)
+        return false;
+
+    int bestIndex = -1, bestTop = height + 1, bestWidth = width + 1;
+    for (unsigned int i=0;i<skyline.size();i++)
+    {
+        int top;
+        if (!fits(i, w, h, top))
+            continue;
+        //lowest top wins, the narrower segment breaks ties so wide gaps stay open
+        if (top + h < bestTop || (top + h == bestTop && skyline[i].width < bestWidth))
+        {
+            bestIndex = i;
+            bestTop = top + h;
+            bestWidth = skyline[i].width;
+        }
+    }
+    if (bestIndex == -1)
+        return false;
+
+    x = skyline[bestIndex].x;
+    y = bestTop - h;
+
+    //raise the skyline under the new rectangle
+    Segment raised;
+    raised.x = x;
+    raised.y = bestTop;
+    raised.width = w;
+    skyline.insert(skyline.begin() + bestIndex, raised);
+    for (unsigned int i=bestIndex + 1;i<skyline.size();)
+    {
+        int covered = (raised.x + raised.width) - skyline[i].x;
+        if (covered <= 0)
+            break;
+        if (covered >= skyline[i].width) //completely under the new one
+        {
+            skyline.erase(skyline.begin() + i);
+            continue;
+        }
+        skyline[i].x += covered;
+        skyline[i].width -= covered;
+        break;
+    }
+    for (unsigned int i=0;i + 1<skyline.size();) //join neighbours at the same height
+    {
+        if (skyline[i].y == skyline[i + 1].y)
+        {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        } else {
+            i++;
+        }
+    }
+    usedArea += (long long)w*h;
+    return true;
+}
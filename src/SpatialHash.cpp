@@ -0,0 +1,127 @@
+#include "SpatialHash.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include "Sprite.h"
+
+SpatialHash::SpatialHash(float cellSize)
+{
+    this->cellSize = cellSize;
+}
+
+void SpatialHash::clear()
+{
+    objects.clear();
+}
+
+void SpatialHash::insert(unsigned int id, glm::vec2 boundsMin, glm::vec2 boundsMax)
+{
+    Object object;
+    object.id = id;
+    object.boundsMin = boundsMin;
+    object.boundsMax = boundsMax;
+    object.cellMinX = (int)std::floor(boundsMin.x/cellSize);
+    object.cellMinY = (int)std::floor(boundsMin.y/cellSize);
+    object.cellMaxX = (int)std::floor(boundsMax.x/cellSize);
+    object.cellMaxY = (int)std::floor(boundsMax.y/cellSize);
+    objects.push_back(object);
+}
+
+void SpatialHash::insert(unsigned int id, const Sprite &sprite)
+{
+    insert(id, sprite.position, sprite.position + sprite.size);
+}
+
+void SpatialHash::insert(unsigned int id, const RSprite &sprite)
+{
+    insert(id, sprite.position, sprite.position + glm::vec2(2.0f*sprite.radius, 2.0f*sprite.radius));
+}
+
+unsigned int SpatialHash::objectCount() const
+{
+    return objects.size();
+}
+
+unsigned int SpatialHash::bucketOf(int cellX, int cellY, unsigned int mask) const
+{
+    //large primes scatter neighbouring cells across the table
+    return ((unsigned int)cellX*73856093u ^ (unsigned int)cellY*19349663u) & mask;
+}
+
+void SpatialHash::findPairs(std::vector<CandidatePair> &pairs)
+{
+    pairs.clear();
+    cellEntries = 0;
+    for (unsigned int i=0;i<objects.size();i++)
+    {
+        const Object &o = objects[i];
+        cellEntries += (o.cellMaxX - o.cellMinX + 1)*(o.cellMaxY - o.cellMinY + 1);
+    }
+    if (cellEntries == 0)
+        return;
+
+    //table at least twice the entry count (power of two), so most buckets hold a single cell
+    unsigned int buckets = 1;
+    while (buckets < 2*cellEntries)
+        buckets *= 2;
+    unsigned int mask = buckets - 1;
+
+    //counting sort of (cell, object) entries by bucket
+    bucketStart.assign(buckets + 1, 0);
+    for (unsigned int i=0;i<objects.size();i++)
+    {
+        const Object &o = objects[i];
+        for (int y=o.cellMinY;y<=o.cellMaxY;y++)
+            for (int x=o.cellMinX;x<=o.cellMaxX;x++)
+                bucketStart[bucketOf(x, y, mask) + 1]++;
+    }
+    for (unsigned int b=0;b<buckets;b++)
+        bucketStart[b + 1] += bucketStart[b];
+    entries.resize(cellEntries);
+    for (unsigned int i=0;i<objects.size();i++)
+    {
+        const Object &o = objects[i];
+        for (int y=o.cellMinY;y<=o.cellMaxY;y++)
+        {
+            for (int x=o.cellMinX;x<=o.cellMaxX;x++)
+            {
+                Entry &e = entries[bucketStart[bucketOf(x, y, mask)]++];
+                e.cellX = x;
+                e.cellY = y;
+                e.object = i;
+            }
+        }
+    }
+    for (unsigned int b=buckets;b>0;b--) //filling moved every start up to the next bucket, move them back
+        bucketStart[b] = bucketStart[b - 1];
+    bucketStart[0] = 0;
+
+    for (unsigned int b=0;b<buckets;b++)
+    {
+        unsigned int end = bucketStart[b + 1];
+        for (unsigned int i=bucketStart[b];i<end;i++)
+        {
+            const Entry &ei = entries[i];
+            const Object &oi = objects[ei.object];
+            for (unsigned int j=i + 1;j<end;j++)
+            {
+                const Entry &ej = entries[j];
+                if (ej.cellX != ei.cellX || ej.cellY != ei.cellY) //another cell that hashed to this bucket
+                    continue;
+                const Object &oj = objects[ej.object];
+                if (oi.boundsMax.x < oj.boundsMin.x || oj.boundsMax.x < oi.boundsMin.x ||
+                    oi.boundsMax.y < oj.boundsMin.y || oj.boundsMax.y < oi.boundsMin.y)
+                    continue;
+                //objects spanning several cells meet in more than one, only report
+                //the pair from the first cell they share
+                if (ei.cellX != std::max(oi.cellMinX, oj.cellMinX) || ei.cellY != std::max(oi.cellMinY, oj.cellMinY))
+                    continue;
+                if (oi.id < oj.id)
+                    pairs.push_back(CandidatePair(oi.id, oj.id));
+                else
+                    pairs.push_back(CandidatePair(oj.id, oi.id));
+            }
+        }
+    }
+}
@@ -0,0 +1,525 @@
+#include "SpectatorServer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#ifdef _WIN32
+#if !defined(_WIN32_WINNT) || _WIN32_WINNT < 0x0600
+#undef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600 //for WSAPoll
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#if defined(__has_include)
+#if __has_include(<afunix.h>)
+#include <afunix.h>
+#define SPECTATE_UNIX
+#endif
+#endif
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define SPECTATE_UNIX
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 //macOS, SO_NOSIGPIPE is set on the socket instead
+#endif
+
+//the little that differs between winsock and POSIX sockets. Handles are kept as
+//long long like UdpLink's, -1 for none
+#ifdef _WIN32
+typedef SOCKET RawSocket;
+typedef WSAPOLLFD PollFd;
+static const RawSocket NO_SOCKET = INVALID_SOCKET;
+#else
+typedef int RawSocket;
+typedef pollfd PollFd;
+static const RawSocket NO_SOCKET = -1;
+#endif
+
+static long long wrap(RawSocket sock)
+{
+    return (sock == NO_SOCKET) ? -1 : (long long)sock;
+}
+
+static RawSocket raw(long long handle)
+{
+    return (handle == -1) ? NO_SOCKET : (RawSocket)handle;
+}
+
+static void closeSocket(long long handle)
+{
+#ifdef _WIN32
+    closesocket(raw(handle));
+#else
+    ::close(raw(handle));
+#endif
+}
+
+static void setNonBlocking(long long handle)
+{
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ioctlsocket(raw(handle), FIONBIO, &nonBlocking);
+#else
+    fcntl(raw(handle), F_SETFL, fcntl(raw(handle), F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+static bool wouldBlock() //the last call failed only because it would have had to wait
+{
+#ifdef _WIN32
+    int error = WSAGetLastError();
+    return error == WSAEWOULDBLOCK || error == WSAEINTR;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+static int lastError()
+{
+#ifdef _WIN32
+    return WSAGetLastError();
+#else
+    return errno;
+#endif
+}
+
+static int pollSockets(PollFd *fds, unsigned int count, int timeout)
+{
+#ifdef _WIN32
+    return WSAPoll(fds, count, timeout);
+#else
+    return poll(fds, count, timeout);
+#endif
+}
+
+static bool makeWake(long long wake[2])
+{
+#ifdef _WIN32
+    //WSAPoll only takes sockets, so a UDP socket that sends to itself stands in for the pipe
+    RawSocket sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock == NO_SOCKET)
+        return false;
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int size = sizeof(address);
+    if (bind(sock, (sockaddr*)&address, sizeof(address)) != 0 || getsockname(sock, (sockaddr*)&address, &size) != 0 ||
+        connect(sock, (sockaddr*)&address, sizeof(address)) != 0)
+    {
+        closesocket(sock);
+        return false;
+    }
+    wake[0] = wake[1] = wrap(sock);
+#else
+    int ends[2];
+    if (pipe(ends) != 0)
+        return false;
+    wake[0] = ends[0];
+    wake[1] = ends[1];
+#endif
+    setNonBlocking(wake[0]);
+    setNonBlocking(wake[1]);
+    return true;
+}
+
+static void signalWake(long long wake[2])
+{
+    char byte = 0;
+#ifdef _WIN32
+    send(raw(wake[1]), &byte, 1, 0); //fine if it fails, a wake up is already waiting
+#else
+    if (write(wake[1], &byte, 1) < 0) {} //fine if the pipe is already full
+#endif
+}
+
+static void drainWake(long long wake[2])
+{
+    char drain[256];
+#ifdef _WIN32
+    while (recv(raw(wake[0]), drain, sizeof(drain), 0) > 0) {}
+#else
+    while (read(wake[0], drain, sizeof(drain)) > 0) {}
+#endif
+}
+
+static void closeWake(long long wake[2])
+{
+    if (wake[0] != -1)
+        closeSocket(wake[0]);
+    if (wake[1] != -1 && wake[1] != wake[0]) //the same socket on Windows
+        closeSocket(wake[1]);
+    wake[0] = wake[1] = -1;
+}
+
+static unsigned char toByte(float value)
+{
+    if (value <= 0.0f)
+        return 0;
+    if (value >= 1.0f)
+        return 255;
+    return (unsigned char)(value*255.0f + 0.5f);
+}
+
+static void putSprite(unsigned char *&out, const Sprite &sprite)
+{
+    SpectatorSprite packed;
+    packed.x = sprite.position.x;
+    packed.y = sprite.position.y;
+    packed.rotation = sprite.rotation;
+    packed.color[0] = toByte(sprite.color.x);
+    packed.color[1] = toByte(sprite.color.y);
+    packed.color[2] = toByte(sprite.color.z);
+    packed.color[3] = 255;
+    memcpy(out, &packed, sizeof(packed));
+    out += sizeof(packed);
+}
+
+SpectatorFrame makeSpectatorFrame(const Simulation &sim, unsigned int effects)
+{
+    unsigned int sprites = (sim.twoPlayer ? 3 : 2) + sim.balls.size();
+    std::vector<unsigned char> *bytes = new std::vector<unsigned char>(sizeof(SpectatorHeader) + sprites*sizeof(SpectatorSprite));
+
+    SpectatorHeader header;
+    memset(&header, 0, sizeof(header));
+    header.size = bytes->size();
+    header.tick = (unsigned int)sim.tick;
+    header.time = SpectatorServer::now();
+    header.flags = (effects & (SPECTATE_SHAKE | SPECTATE_INVERT)) | (sim.lost ? SPECTATE_LOST : 0) | (sim.twoPlayer ? SPECTATE_TWO_PLAYER : 0);
+    header.loser = sim.loser;
+    header.ballCount = sim.balls.size();
+    unsigned char *out = &(*bytes)[0];
+    memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    putSprite(out, sim.paddle);
+    if (sim.twoPlayer)
+        putSprite(out, sim.paddle2);
+    putSprite(out, sim.ball);
+    for (unsigned int i=0;i<sim.balls.size();i++)
+        putSprite(out, sim.balls[i]);
+    return SpectatorFrame(bytes);
+}
+
+SpectatorServer::SpectatorServer()
+{
+    listeners[0] = listeners[1] = -1;
+    wake[0] = wake[1] = -1;
+#ifdef _WIN32
+    WSADATA wsa;
+    WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+}
+
+SpectatorServer::~SpectatorServer()
+{
+    stop();
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+double SpectatorServer::now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool SpectatorServer::listenOn(long long fd, bool isTcp)
+{
+    if (listen(raw(fd), SOMAXCONN) != 0 || listenerCount == 2)
+    {
+        closeSocket(fd);
+        return false;
+    }
+    setNonBlocking(fd);
+    listeners[listenerCount] = fd;
+    tcp[listenerCount] = isTcp;
+    listenerCount++;
+    return true;
+}
+
+bool SpectatorServer::listenTcp(unsigned short port)
+{
+    long long fd = wrap(socket(AF_INET, SOCK_STREAM, 0));
+    if (fd == -1)
+        return false;
+#ifndef _WIN32 //on Windows this would let another process take the port too
+    int yes = 1;
+    setsockopt(raw(fd), SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+#endif
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(raw(fd), (sockaddr*)&address, sizeof(address)) != 0)
+    {
+        std::cout << "Couldn't bind TCP port " << port << " for spectators" << std::endl;
+        closeSocket(fd);
+        return false;
+    }
+    return listenOn(fd, true);
+}
+
+bool SpectatorServer::listenUnix(const std::string &path)
+{
+#ifdef SPECTATE_UNIX
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    if (path.size() >= sizeof(address.sun_path))
+        return false;
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path.c_str());
+    long long fd = wrap(socket(AF_UNIX, SOCK_STREAM, 0));
+    if (fd == -1)
+    {
+        std::cout << "Couldn't make a Unix socket for spectators" << std::endl;
+        return false;
+    }
+    std::remove(path.c_str()); //left over from a run that didn't stop cleanly
+    if (bind(raw(fd), (sockaddr*)&address, sizeof(address)) != 0)
+    {
+        std::cout << "Couldn't bind " << path << " for spectators" << std::endl;
+        closeSocket(fd);
+        return false;
+    }
+    unixPath = path;
+    return listenOn(fd, false);
+#else
+    std::cout << "Unix sockets aren't supported by this build, use --spectate-port" << std::endl;
+    return false;
+#endif
+}
+
+bool SpectatorServer::start()
+{
+    if (listenerCount == 0 || running)
+        return false;
+    if (!makeWake(wake))
+        return false;
+
+#ifndef _WIN32
+    //a descriptor per client, the default soft limit is often only 1024
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+#endif
+
+    running = true;
+    thread = std::thread(&SpectatorServer::run, this);
+    return true;
+}
+
+void SpectatorServer::stop()
+{
+    if (running)
+    {
+        running = false;
+        signalWake(wake); //poll() returns
+        thread.join();
+    }
+    for (unsigned int i=0;i<list.size();i++)
+        closeSocket(list[i].fd);
+    list.clear();
+    clients = 0;
+    for (unsigned int i=0;i<listenerCount;i++)
+        closeSocket(listeners[i]);
+    listenerCount = 0;
+    if (!unixPath.empty())
+        std::remove(unixPath.c_str());
+    unixPath.clear();
+    closeWake(wake);
+}
+
+void SpectatorServer::broadcast(const SpectatorFrame &frame)
+{
+    if (!running)
+        return;
+    frames.push(frame); //dropped if the network thread is 256 ticks behind, counted by the ring
+    if (!woken.exchange(true)) //one wake up per batch of frames is enough
+        signalWake(wake);
+}
+
+void SpectatorServer::run()
+{
+    std::vector<PollFd> fds;
+    while (running)
+    {
+        //the wake pipe, the listeners, then one per client in list order
+        fds.resize(1 + listenerCount + list.size());
+        fds[0].fd = raw(wake[0]);
+        fds[0].events = POLLIN;
+        for (unsigned int i=0;i<listenerCount;i++)
+        {
+            fds[1 + i].fd = raw(listeners[i]);
+            fds[1 + i].events = POLLIN;
+        }
+        for (unsigned int i=0;i<list.size();i++)
+        {
+            PollFd &p = fds[1 + listenerCount + i];
+            p.fd = raw(list[i].fd);
+            p.events = POLLIN | (list[i].queue.empty() ? 0 : POLLOUT);
+        }
+        for (unsigned int i=0;i<fds.size();i++)
+            fds[i].revents = 0;
+        if (pollSockets(&fds[0], fds.size(), 100) < 0 && !wouldBlock())
+        {
+            std::cout << "Spectator server poll failed, error " << lastError() << std::endl;
+            break;
+        }
+        double time = now();
+
+        if (fds[0].revents & POLLIN)
+            drainWake(wake);
+        woken = false; //frames pushed after this wake us again
+        //every new frame goes on every queue, that's a reference each, not a copy
+        const SpectatorFrame *next;
+        while ((next = frames.front()))
+        {
+            for (unsigned int i=0;i<list.size();i++)
+                enqueue(list[i], *next, time);
+            frames.pop(); //the ring's slot keeps its reference until it's reused, that's fine
+        }
+
+        //send to everyone with something queued without waiting for POLLOUT, nearly all of
+        //them can take it right away. Backwards so a client can be removed in place
+        for (int i=(int)list.size() - 1;i>=0;i--)
+        {
+            short revents = fds[1 + listenerCount + i].revents;
+            bool alive = !(revents & (POLLERR | POLLHUP | POLLNVAL));
+            if (alive && (revents & POLLIN)) //spectators have nothing to say, so this is them leaving
+            {
+                char discard[256];
+                int got = recv(raw(list[i].fd), discard, sizeof(discard), 0);
+                alive = (got > 0) || (got < 0 && wouldBlock());
+            }
+            if (alive && !list[i].queue.empty())
+                alive = flush(list[i], time);
+            if (!alive)
+            {
+                closeSocket(list[i].fd);
+                if (i != (int)list.size() - 1)
+                    list[i] = std::move(list.back());
+                list.pop_back();
+                clients = list.size();
+            }
+        }
+
+        for (unsigned int i=0;i<listenerCount;i++)
+        {
+            if (fds[1 + i].revents & POLLIN)
+                accept(i, time);
+        }
+    }
+}
+
+void SpectatorServer::accept(unsigned int listener, double time)
+{
+    while (true)
+    {
+        long long fd = wrap(::accept(raw(listeners[listener]), NULL, NULL));
+        if (fd == -1)
+            return; //none left, or out of descriptors (the rest wait in the backlog)
+        setNonBlocking(fd);
+        int yes = 1;
+        if (tcp[listener]) //frames are small and latency matters more than packet count
+            setsockopt(raw(fd), IPPROTO_TCP, TCP_NODELAY, (const char*)&yes, sizeof(yes));
+#ifdef SO_NOSIGPIPE
+        setsockopt(raw(fd), SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+#endif
+        Client client;
+        client.fd = fd;
+        client.offset = 0;
+        client.lastProgress = time;
+        list.push_back(std::move(client));
+        clients = list.size();
+    }
+}
+
+void SpectatorServer::enqueue(Client &client, const SpectatorFrame &frame, double time)
+{
+    if (client.queue.empty())
+        client.lastProgress = time; //the stall clock starts when it has something to take
+    if (client.queue.size() >= MAX_QUEUED)
+    {
+        //too far behind: skip its oldest tick, but not one that's partly sent
+        client.queue.erase(client.queue.begin() + ((client.offset > 0) ? 1 : 0));
+        framesDropped++;
+    }
+    client.queue.push_back(frame);
+}
+
+bool SpectatorServer::flush(Client &client, double time)
+{
+    //gather the queued frames into one send, straight from the shared buffers
+    unsigned int count = 0;
+    long long sent;
+#ifdef _WIN32
+    WSABUF parts[MAX_GATHER];
+    for (;count<client.queue.size() && count<MAX_GATHER;count++)
+    {
+        const std::vector<unsigned char> &bytes = *client.queue[count];
+        size_t skip = (count == 0) ? client.offset : 0;
+        parts[count].buf = (CHAR*)(&bytes[0] + skip);
+        parts[count].len = bytes.size() - skip;
+    }
+    DWORD done = 0;
+    sent = (WSASend(raw(client.fd), parts, count, &done, 0, NULL, NULL) == 0) ? (long long)done : -1;
+#else
+    iovec parts[MAX_GATHER];
+    for (;count<client.queue.size() && count<MAX_GATHER;count++)
+    {
+        const std::vector<unsigned char> &bytes = *client.queue[count];
+        size_t skip = (count == 0) ? client.offset : 0;
+        parts[count].iov_base = (void*)(&bytes[0] + skip);
+        parts[count].iov_len = bytes.size() - skip;
+    }
+    msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = parts;
+    message.msg_iovlen = count;
+    sent = sendmsg(raw(client.fd), &message, MSG_NOSIGNAL);
+#endif
+    if (sent < 0)
+    {
+        if (!wouldBlock())
+            return false;
+        if (time - client.lastProgress > stallTimeout)
+        {
+            kicked++;
+            return false;
+        }
+        return true;
+    }
+
+    client.lastProgress = time;
+    bytesSent += sent;
+    while (sent > 0)
+    {
+        size_t left = client.queue.front()->size() - client.offset;
+        if ((size_t)sent < left)
+        {
+            client.offset += sent;
+            break;
+        }
+        sent -= left;
+        client.offset = 0;
+        client.queue.pop_front();
+        framesSent++;
+    }
+    return true;
+}
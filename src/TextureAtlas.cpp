@@ -0,0 +1,65 @@
+#include "TextureAtlas.h"
+
+#include <GL/glew.h>
+#include <iostream>
+#include <glm/glm.hpp>
+#include "Texture.h"
+#include "SkylinePacker.h"
+
+TextureAtlas::TextureAtlas(int width, int height, int padding)
+    : packer(width, height)
+{
+    this->padding = padding;
+    texture.Wrap_S = GL_CLAMP_TO_EDGE;
+    texture.Wrap_T = GL_CLAMP_TO_EDGE;
+    texture.Generate(width, height, NULL); //storage only, images are copied in as they're placed
+
+    unsigned char white[] = {255, 255, 255, 255};
+    blank = add(1, 1, white);
+}
+
+glm::vec4 TextureAtlas::rectFor(int x, int y, int width, int height) const
+{
+    //pulled in half a texel on each side so linear filtering only ever reads this image
+    float atlasWidth = packer.width, atlasHeight = packer.height;
+    return glm::vec4((x + 0.5f)/atlasWidth, (y + 0.5f)/atlasHeight,
+                     (width - 1.0f)/atlasWidth, (height - 1.0f)/atlasHeight);
+}
+
+AtlasHandle TextureAtlas::reserve()
+{
+    AtlasHandle handle = uvRects.size();
+    uvRects.push_back(uvRects.empty() ? glm::vec4(0.0, 0.0, 0.0, 0.0) : uvRects[blank]);
+    placed.push_back(glm::vec4(0.0, 0.0, 0.0, 0.0));
+    return handle;
+}
+
+bool TextureAtlas::place(AtlasHandle handle, int width, int height, int &x, int &y)
+{
+    if (!packer.pack(width + 2*padding, height + 2*padding, x, y))
+        return false;
+    x += padding;
+    y += padding;
+    placed[handle] = rectFor(x, y, width, height);
+    return true;
+}
+
+void TextureAtlas::activate(AtlasHandle handle)
+{
+    uvRects[handle] = placed[handle];
+}
+
+AtlasHandle TextureAtlas::add(int width, int height, const unsigned char *rgba)
+{
+    AtlasHandle handle = reserve();
+    int x, y;
+    if (!place(handle, width, height, x, y))
+    {
+        std::cout << "Texture atlas is full, a " << width << "x" << height << " image was left blank" << std::endl;
+        return handle;
+    }
+    texture.Bind();
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+    activate(handle);
+    return handle;
+}
@@ -0,0 +1,197 @@
+#include "TextureLoader.h"
+
+#include <cstring>
+#include <iostream>
+#include <GL/glew.h>
+#include <SOIL.h>
+#include "Texture.h"
+#include "TextureAtlas.h"
+#include "Profiler.h"
+
+TextureLoader::TextureLoader(unsigned int threads)
+{
+    if (threads == 0)
+        threads = 1;
+    for (unsigned int i=0;i<threads;i++)
+        workers.push_back(std::thread(&TextureLoader::decodeLoop, this));
+}
+
+TextureLoader::~TextureLoader()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (unsigned int i=0;i<workers.size();i++)
+        workers[i].join();
+
+    for (unsigned int i=0;i<decoded.size();i++) //decoded but never uploaded
+        SOIL_free_image_data(decoded[i]->pixels);
+    for (unsigned int i=0;i<uploading.size();i++)
+    {
+        glDeleteSync(uploading[i]->fence);
+        glDeleteBuffers(1, &uploading[i]->pbo);
+    }
+}
+
+std::shared_future<bool> TextureLoader::load(const std::string &path, Texture2D &slot, const Texture2D &placeholder)
+{
+    std::shared_ptr<Job> job(new Job());
+    job->path = path;
+    job->slot = &slot;
+    slot = placeholder;
+    return queue(job);
+}
+
+std::shared_future<bool> TextureLoader::load(const std::string &path, TextureAtlas &atlas, AtlasHandle handle)
+{
+    std::shared_ptr<Job> job(new Job());
+    job->path = path;
+    job->atlas = &atlas;
+    job->handle = handle;
+    return queue(job);
+}
+
+std::shared_future<bool> TextureLoader::queue(std::shared_ptr<Job> job)
+{
+    std::shared_future<bool> ready = job->done.get_future().share();
+    requested++;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        toDecode.push_back(job);
+    }
+    wake.notify_one();
+    return ready;
+}
+
+unsigned int TextureLoader::pending()
+{
+    return requested - finished;
+}
+
+void TextureLoader::decodeLoop()
+{
+    while (true)
+    {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [this]() { return stopping || !toDecode.empty(); });
+            if (stopping)
+                return;
+            job = toDecode.front();
+            toDecode.pop_front();
+        }
+
+        //the slow part, off the GL thread. Everything is decoded as RGBA so it can go straight into the PBO
+        job->pixels = SOIL_load_image(job->path.c_str(), &job->width, &job->height, 0, SOIL_LOAD_RGBA);
+
+        std::lock_guard<std::mutex> guard(lock);
+        decoded.push_back(job);
+    }
+}
+
+bool TextureLoader::startUpload(Job &job)
+{
+    int x = 0, y = 0;
+    if (job.atlas && !job.atlas->place(job.handle, job.width, job.height, x, y))
+    {
+        std::cout << "No room in the texture atlas for " << job.path << std::endl;
+        SOIL_free_image_data(job.pixels);
+        job.pixels = nullptr;
+        return false;
+    }
+
+    GLsizeiptr bytes = (GLsizeiptr)job.width*job.height*4;
+    glGenBuffers(1, &job.pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, job.pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+    void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    bool filled = false;
+    if (mapped)
+    {
+        memcpy(mapped, job.pixels, bytes);
+        filled = (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE); //false if the contents were lost
+    }
+
+    //with a PBO bound the data pointer is an offset into it, so these return right away
+    //and the driver copies the pixels into the texture in the background
+    unsigned char *source = 0;
+    if (!filled) //the PBO has nothing in it, upload straight from memory instead (stalls, but it's right)
+    {
+        std::cout << "Couldn't map a pixel buffer for " << job.path << ", uploading it directly" << std::endl;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &job.pbo);
+        job.pbo = 0;
+        source = job.pixels;
+    }
+    if (job.atlas)
+    {
+        job.atlas->texture.Bind();
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, job.width, job.height, GL_RGBA, GL_UNSIGNED_BYTE, source);
+    } else {
+        job.texture.reset(new Texture2D());
+        job.texture->Generate(job.width, job.height, source);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    SOIL_free_image_data(job.pixels);
+    job.pixels = nullptr;
+    job.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    return true;
+}
+
+void TextureLoader::poll()
+{
+    PROFILE_SCOPE("texture uploads");
+
+    //swap in the textures the GPU has finished copying
+    for (unsigned int i=0;i<uploading.size();)
+    {
+        Job &job = *uploading[i];
+        GLenum status = glClientWaitSync(job.fence, 0, 0); //don't wait, just ask
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        {
+            i++;
+            continue;
+        }
+        glDeleteSync(job.fence);
+        glDeleteBuffers(1, &job.pbo);
+        if (job.atlas)
+            job.atlas->activate(job.handle);
+        else
+            *job.slot = *job.texture;
+        job.done.set_value(true);
+        finished++;
+        uploading.erase(uploading.begin() + i);
+    }
+
+    //start uploads for freshly decoded images, at least one per poll so big ones still get through
+    GLsizeiptr budget = uploadBudget;
+    bool started = false;
+    while (true)
+    {
+        std::shared_ptr<Job> job;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (decoded.empty())
+                break;
+            GLsizeiptr bytes = (GLsizeiptr)decoded.front()->width*decoded.front()->height*4;
+            if (started && bytes > budget)
+                break;
+            budget -= bytes;
+            job = decoded.front();
+            decoded.pop_front();
+        }
+        if (!job->pixels)
+            std::cout << "Failed to load texture " << job->path << std::endl;
+        if (!job->pixels || !startUpload(*job))
+        {
+            job->done.set_value(false);
+            finished++;
+            continue;
+        }
+        uploading.push_back(job);
+        started = true;
+    }
+}
@@ -0,0 +1,195 @@
+#include "UdpLink.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+UdpLink::UdpLink()
+{
+}
+
+UdpLink::~UdpLink()
+{
+    close();
+}
+
+double UdpLink::now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool UdpLink::open(unsigned short port)
+{
+    close();
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+        return false;
+    SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock == INVALID_SOCKET)
+        return false;
+    u_long nonBlocking = 1;
+    ioctlsocket(sock, FIONBIO, &nonBlocking);
+#else
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock == -1)
+        return false;
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    handle = (long long)sock;
+
+    sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(port);
+    if (bind(sock, (sockaddr*)&local, sizeof(local)) != 0)
+    {
+        std::cout << "Couldn't bind UDP port " << port << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool UdpLink::listen(unsigned short port)
+{
+    return open(port);
+}
+
+bool UdpLink::connect(const std::string &address, unsigned short port)
+{
+    if (!open(0))
+        return false;
+    addrinfo hints, *found = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(address.c_str(), NULL, &hints, &found) != 0 || !found)
+    {
+        std::cout << "Couldn't resolve " << address << std::endl;
+        close();
+        return false;
+    }
+    peerAddress = ((sockaddr_in*)found->ai_addr)->sin_addr.s_addr;
+    peerPort = htons(port);
+    freeaddrinfo(found);
+    return true;
+}
+
+void UdpLink::close()
+{
+    if (handle == -1)
+        return;
+#ifdef _WIN32
+    closesocket((SOCKET)handle);
+    WSACleanup();
+#else
+    ::close((int)handle);
+#endif
+    handle = -1;
+    peerAddress = 0;
+    peerPort = 0;
+    delayed.clear();
+}
+
+float UdpLink::random()
+{
+    unsigned int x = rngState; //xorshift32, like the simulation's
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rngState = x;
+    return (x >> 8)/16777216.0f;
+}
+
+bool UdpLink::send(const void *data, unsigned int size)
+{
+    if (!hasPeer() || size > MAX_PACKET)
+        return false;
+    sent++;
+    bytesSent += size;
+    if (loss > 0.0f && random() < loss)
+    {
+        dropped++;
+        return true; //as far as the caller can tell it went out
+    }
+    if (latency <= 0.0f && jitter <= 0.0f)
+        return sendNow(data, size);
+
+    Delayed packet;
+    packet.due = now() + (latency + jitter*random())/1000.0;
+    packet.data.assign((const unsigned char*)data, (const unsigned char*)data + size);
+    delayed.push_back(packet);
+    return true;
+}
+
+void UdpLink::pump()
+{
+    if (delayed.empty())
+        return;
+    double time = now();
+    for (unsigned int i=0;i<delayed.size();)
+    {
+        if (delayed[i].due <= time)
+        {
+            sendNow(&delayed[i].data[0], delayed[i].data.size());
+            delayed[i] = delayed.back(); //order doesn't matter, jitter reorders anyway
+            delayed.pop_back();
+        } else {
+            i++;
+        }
+    }
+}
+
+bool UdpLink::sendNow(const void *data, unsigned int size)
+{
+    sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = peerAddress;
+    to.sin_port = peerPort;
+#ifdef _WIN32
+    return sendto((SOCKET)handle, (const char*)data, size, 0, (sockaddr*)&to, sizeof(to)) == (int)size;
+#else
+    return sendto((int)handle, data, size, 0, (sockaddr*)&to, sizeof(to)) == (ssize_t)size;
+#endif
+}
+
+int UdpLink::receive(void *data, unsigned int size)
+{
+    pump(); //anything due goes out first, so a loop that only receives still sends
+    while (true)
+    {
+        sockaddr_in from;
+#ifdef _WIN32
+        int fromSize = sizeof(from);
+        int got = recvfrom((SOCKET)handle, (char*)data, size, 0, (sockaddr*)&from, &fromSize);
+#else
+        socklen_t fromSize = sizeof(from);
+        int got = recvfrom((int)handle, data, size, 0, (sockaddr*)&from, &fromSize);
+#endif
+        if (got < 0)
+            return -1;
+        if (!hasPeer()) //listening, the first one to talk is the peer
+        {
+            peerAddress = from.sin_addr.s_addr;
+            peerPort = from.sin_port;
+        }
+        if (from.sin_addr.s_addr != peerAddress || from.sin_port != peerPort)
+            continue; //someone else, ignore them
+        received++;
+        return got;
+    }
+}
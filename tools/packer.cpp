@@ -0,0 +1,102 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <SOIL.h>
+#include "AssetPack.h"
+
+//bakes loose assets into one pack for the game, build with the Packer target
+//  pong_pack OUTPUT FILE...
+//images are decoded to RGBA here so the game never has to, .glsl/.vert/.frag/.geom
+//files are stored as shader sources and everything else as raw data
+
+using namespace std;
+
+static const unsigned int FORMAT_RGBA = 0x1908; //GL_RGBA, the tool doesn't need GL itself
+
+static bool endsWith(const string &text, const char *suffix)
+{
+    size_t length = strlen(suffix);
+    if (text.size() < length)
+        return false;
+    for (size_t i=0;i<length;i++)
+    {
+        char c = text[text.size() - length + i];
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+        if (c != suffix[i])
+            return false;
+    }
+    return true;
+}
+
+static bool readFile(const string &path, vector<unsigned char> &bytes)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    unsigned char buffer[65536];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        bytes.insert(bytes.end(), buffer, buffer + got);
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        cout << "usage: pong_pack OUTPUT FILE..." << endl;
+        return 1;
+    }
+
+    AssetPackWriter pack;
+    for (int i=2;i<argc;i++)
+    {
+        string path = argv[i];
+        string name = path; //looked up by this at runtime, with forward slashes on every platform
+        for (size_t c=0;c<name.size();c++)
+        {
+            if (name[c] == '\\')
+                name[c] = '/';
+        }
+
+        if (endsWith(path, ".png") || endsWith(path, ".jpg") || endsWith(path, ".bmp") || endsWith(path, ".tga"))
+        {
+            int width, height;
+            unsigned char *pixels = SOIL_load_image(path.c_str(), &width, &height, 0, SOIL_LOAD_RGBA);
+            if (!pixels)
+            {
+                cout << "Couldn't decode " << path << ": " << SOIL_last_result() << endl;
+                return 1;
+            }
+            bool added = pack.add(name, ASSET_TEXTURE, pixels, (size_t)width*height*4, FORMAT_RGBA, width, height);
+            SOIL_free_image_data(pixels);
+            if (!added)
+                return 1;
+            cout << "texture " << name << " " << width << "x" << height << endl;
+            continue;
+        }
+
+        vector<unsigned char> bytes;
+        if (!readFile(path, bytes))
+        {
+            cout << "Couldn't read " << path << endl;
+            return 1;
+        }
+        bool shader = endsWith(path, ".glsl") || endsWith(path, ".vert") || endsWith(path, ".frag") || endsWith(path, ".geom");
+        if (!pack.add(name, shader ? ASSET_SHADER : ASSET_DATA, bytes.empty() ? NULL : &bytes[0], bytes.size()))
+            return 1;
+        cout << (shader ? "shader " : "data ") << name << " " << bytes.size() << " bytes" << endl;
+    }
+
+    if (!pack.write(argv[1]))
+    {
+        cout << "Couldn't write " << argv[1] << endl;
+        return 1;
+    }
+    cout << "wrote " << argv[1] << endl;
+    return 0;
+}
@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#if !defined(_WIN32_WINNT) || _WIN32_WINNT < 0x0600
+#undef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600 //for WSAPoll
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#if defined(__has_include)
+#if __has_include(<afunix.h>)
+#include <afunix.h>
+#define SPECTATE_UNIX
+#endif
+#endif
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define SPECTATE_UNIX
+#endif
+#include "SpectatorServer.h"
+
+//connects more and more spectators to a server and measures how long each tick takes
+//to reach them, build with the SpectateLoad target
+//  pong_spectate_load PORT|HOST:PORT|unix:PATH [--clients 1,10,100,1000] [--seconds S]
+//latency is from the frame being built to it being read here, so run it on the same
+//machine as the server (pong_headless --spectate-port, or the game with --spectate-port)
+
+using namespace std;
+
+#ifdef _WIN32
+typedef SOCKET RawSocket;
+typedef WSAPOLLFD PollFd;
+static const RawSocket NO_SOCKET = INVALID_SOCKET;
+#else
+typedef int RawSocket;
+typedef pollfd PollFd;
+static const RawSocket NO_SOCKET = -1;
+#endif
+
+static void closeSocket(RawSocket fd)
+{
+#ifdef _WIN32
+    closesocket(fd);
+#else
+    close(fd);
+#endif
+}
+
+static int pollSockets(PollFd *fds, unsigned int count, int timeout)
+{
+#ifdef _WIN32
+    return WSAPoll(fds, count, timeout);
+#else
+    return poll(fds, count, timeout);
+#endif
+}
+
+static bool wouldBlock()
+{
+#ifdef _WIN32
+    int error = WSAGetLastError();
+    return error == WSAEWOULDBLOCK || error == WSAEINTR;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+static double now() //the same clock as SpectatorServer::now()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Target {
+    bool isUnix = false;
+    string path; //unix
+    sockaddr_in address; //TCP
+};
+
+struct Spectator {
+    RawSocket fd;
+    vector<unsigned char> buffer; //bytes of frames not complete yet
+    unsigned int lastTick;
+    unsigned long long frames;
+};
+
+static RawSocket connectTo(const Target &target)
+{
+    RawSocket fd = NO_SOCKET;
+    if (target.isUnix)
+    {
+#ifdef SPECTATE_UNIX
+        sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, target.path.c_str(), sizeof(address.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd != NO_SOCKET && connect(fd, (sockaddr*)&address, sizeof(address)) != 0)
+        {
+            closeSocket(fd);
+            fd = NO_SOCKET;
+        }
+#endif
+    } else {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd != NO_SOCKET && connect(fd, (sockaddr*)&target.address, sizeof(target.address)) != 0)
+        {
+            closeSocket(fd);
+            fd = NO_SOCKET;
+        }
+    }
+    if (fd != NO_SOCKET)
+    {
+#ifdef _WIN32
+        u_long nonBlocking = 1;
+        ioctlsocket(fd, FIONBIO, &nonBlocking);
+#else
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    }
+    return fd;
+}
+
+static double percentile(vector<double> &values, double p)
+{
+    if (values.empty())
+        return 0.0;
+    size_t index = min(values.size() - 1, (size_t)(p/100.0*values.size()));
+    nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        cout << "usage: pong_spectate_load PORT|HOST:PORT|unix:PATH [--clients 1,10,100,1000] [--seconds S]" << endl;
+        return 1;
+    }
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+        return 1;
+#endif
+    Target target;
+    string where = argv[1];
+    if (where.compare(0, 5, "unix:") == 0)
+    {
+#ifndef SPECTATE_UNIX
+        cout << "Unix sockets aren't supported by this build" << endl;
+        return 1;
+#endif
+        target.isUnix = true;
+        target.path = where.substr(5);
+    } else {
+        size_t colon = where.rfind(':');
+        string host = (colon != string::npos) ? where.substr(0, colon) : "127.0.0.1";
+        memset(&target.address, 0, sizeof(target.address));
+        target.address.sin_family = AF_INET;
+        target.address.sin_port = htons(atoi(where.c_str() + ((colon != string::npos) ? colon + 1 : 0)));
+        if (inet_pton(AF_INET, host.c_str(), &target.address.sin_addr) != 1)
+        {
+            cout << "Not an IPv4 address: " << host << endl;
+            return 1;
+        }
+    }
+    vector<unsigned int> counts;
+    double seconds = 5.0;
+    for (int i=2;i<argc;i++)
+    {
+        if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc)
+        {
+            const char *list = argv[++i];
+            while (*list)
+            {
+                char *end;
+                unsigned int count = strtoul(list, &end, 10);
+                if (end == list) //not a number
+                    break;
+                if (count > 0)
+                    counts.push_back(count);
+                list = (*end == ',') ? end + 1 : end;
+            }
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        }
+    }
+    if (counts.empty())
+    {
+        unsigned int defaults[] = {1, 10, 100, 1000};
+        counts.assign(defaults, defaults + 4);
+    }
+
+#ifndef _WIN32
+    rlimit limit; //a descriptor per spectator
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+#endif
+
+    printf("%10s %10s %10s %10s %10s %12s %12s\n", "clients", "frames/s", "p50 ms", "p99 ms", "max ms", "skipped", "disconnects");
+    for (unsigned int c=0;c<counts.size();c++)
+    {
+        vector<Spectator> spectators;
+        for (unsigned int i=0;i<counts[c];i++)
+        {
+            Spectator spectator;
+            spectator.fd = connectTo(target);
+            if (spectator.fd == NO_SOCKET)
+            {
+#ifdef _WIN32
+                cout << "Couldn't connect spectator " << i + 1 << ", error " << WSAGetLastError() << endl;
+#else
+                cout << "Couldn't connect spectator " << i + 1 << ": " << strerror(errno) << endl;
+#endif
+                break;
+            }
+            spectator.lastTick = 0;
+            spectator.frames = 0;
+            spectators.push_back(spectator);
+        }
+        if (spectators.size() < counts[c])
+        {
+            for (unsigned int i=0;i<spectators.size();i++)
+                closeSocket(spectators[i].fd);
+            return 1;
+        }
+
+        //the first half second only drains what queued up while connecting
+        vector<PollFd> fds(spectators.size());
+        for (unsigned int i=0;i<spectators.size();i++)
+        {
+            fds[i].fd = spectators[i].fd;
+            fds[i].events = POLLIN;
+        }
+        vector<double> latencies;
+        unsigned long long skipped = 0, disconnects = 0, frames = 0;
+        unsigned char chunk[65536];
+        double start = now();
+        double measureFrom = start + 0.5;
+        double end = measureFrom + seconds;
+        while (now() < end)
+        {
+            if (pollSockets(&fds[0], fds.size(), 100) < 0 && !wouldBlock())
+                break;
+            for (unsigned int i=0;i<fds.size();i++)
+            {
+                if (fds[i].fd == NO_SOCKET || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                    continue;
+                Spectator &spectator = spectators[i];
+                int got = recv(spectator.fd, (char*)chunk, sizeof(chunk), 0);
+                if (got <= 0)
+                {
+                    if (got < 0 && wouldBlock())
+                        continue;
+                    disconnects++;
+                    closeSocket(spectator.fd);
+                    fds[i].fd = NO_SOCKET; //poll skips it from now on
+                    continue;
+                }
+                double received = now();
+                spectator.buffer.insert(spectator.buffer.end(), chunk, chunk + got);
+                size_t used = 0;
+                while (spectator.buffer.size() - used >= sizeof(SpectatorHeader))
+                {
+                    SpectatorHeader header;
+                    memcpy(&header, &spectator.buffer[used], sizeof(header));
+                    if (header.size < sizeof(header) || spectator.buffer.size() - used < header.size)
+                        break;
+                    used += header.size;
+                    if (received >= measureFrom)
+                    {
+                        latencies.push_back((received - header.time)*1000.0);
+                        frames++;
+                        //ticks restart when a match does, only count gaps going forward
+                        if (spectator.frames > 0 && header.tick > spectator.lastTick + 1)
+                            skipped += header.tick - spectator.lastTick - 1;
+                        spectator.frames++;
+                    }
+                    spectator.lastTick = header.tick;
+                }
+                spectator.buffer.erase(spectator.buffer.begin(), spectator.buffer.begin() + used);
+            }
+        }
+        for (unsigned int i=0;i<fds.size();i++)
+        {
+            if (fds[i].fd != NO_SOCKET)
+                closeSocket(fds[i].fd);
+        }
+
+        double perSecond = frames/seconds/spectators.size();
+        double p50 = percentile(latencies, 50.0), p99 = percentile(latencies, 99.0);
+        double worst = latencies.empty() ? 0.0 : *max_element(latencies.begin(), latencies.end());
+        printf("%10u %10.1f %10.3f %10.3f %10.3f %12llu %12llu\n", counts[c], perSecond, p50, p99, worst, skipped, disconnects);
+        fflush(stdout);
+    }
+    return 0;
+}